@@ -4,22 +4,41 @@
 #include <unistd.h>
 #include <libcups3/cups/cups.h>
 #include <ctype.h>
+#include <stdbool.h>
+#include <time.h>
+#include "ipp-stream.h"
+#include "status-shm.h"
 
-void print_octetstring_attribute(ipp_attribute_t *attr, const char *name);
-void print_enum_attribute(ipp_attribute_t *attr, const char *name);
+// Growable in-memory IPP message for the benchmark
+typedef struct {
+    ipp_uchar_t *data;
+    size_t       length;
+    size_t       size;
+    size_t       offset;
+} MemoryBuffer;
+
+void print_octetstring_attribute(const IppStreamAttr *attr, const char *name);
+void print_enum_attribute(const IppStreamAttr *attr, const char *name);
+int run_benchmark(http_t *http, ipp_t *request, int iterations);
+ssize_t memory_write(void *context, ipp_uchar_t *buffer, size_t bytes);
+ssize_t memory_read(void *context, ipp_uchar_t *buffer, size_t bytes);
+double elapsed_ns(const struct timespec *start);
+int print_status_board(const char *hostname, int port);
 
 int main(int argc, char *argv[]) {
     const char *uri_hostname = NULL;
     int port = 8000;
     http_t *http = NULL;
-    ipp_t *request = NULL, *response = NULL;
-    ipp_status_t status;
+    ipp_t *request = NULL;
+    IppStreamResponse response;
+    int iterations = 0;
+    bool use_board = false;
     char printer_uri_str[256];
 
     int opt;
     opterr = 0;
 
-    while ((opt = getopt(argc, argv, "h:p:")) != -1) {
+    while ((opt = getopt(argc, argv, "h:p:b:s")) != -1) {
         switch (opt) {
             case 'h':
                 uri_hostname = optarg;
@@ -27,8 +46,14 @@ int main(int argc, char *argv[]) {
             case 'p':
                 port = atoi(optarg);
                 break;
+            case 'b':
+                iterations = atoi(optarg);
+                break;
+            case 's':
+                use_board = true;
+                break;
             case '?':
-                if (optopt == 'h' || optopt == 'p')
+                if (optopt == 'h' || optopt == 'p' || optopt == 'b')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 else if (isprint(optopt))
                     fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -41,12 +66,18 @@ int main(int argc, char *argv[]) {
     }
 
     if (uri_hostname == NULL) {
-        fprintf(stderr, "Usage: %s -h <hostname> [-p <port>]\n", argv[0]);
+        fprintf(stderr, "Usage: %s -h <hostname> [-p <port>] [-b <iterations>] [-s]\n", argv[0]);
         fprintf(stderr, "  -h <hostname>:  Hostname or IP address of the printer (required).\n");
         fprintf(stderr, "  -p <port>:      Port number for the printer (optional, default is 631).\n");
+        fprintf(stderr, "  -b <iterations>: Benchmark parsing the printer's response as ipp_t and with ipp-stream (optional).\n");
+        fprintf(stderr, "  -s:             Read the state status-board last published instead of asking the printer (optional).\n");
         return 1;
     }
 
+    if (use_board) {
+        return print_status_board(uri_hostname, port);
+    }
+
     http_encryption_t encryption = (port == 8000) ? HTTP_ENCRYPTION_ALWAYS : HTTP_ENCRYPTION_IF_REQUESTED;
     http = httpConnect(uri_hostname, port, NULL, AF_UNSPEC, encryption, 1, 30000, NULL);
 
@@ -65,29 +96,32 @@ int main(int argc, char *argv[]) {
     ippAddStrings(request, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD),
                   "requested-attributes", 2, NULL, requested_attrs);
 
-    response = cupsDoRequest(http, request, "/ipp/print");
+    if (iterations > 0) {
+        int result = run_benchmark(http, request, iterations);
+        ippDelete(request);
+        httpClose(http);
+        return result;
+    }
 
-    if (response == NULL) {
-        fprintf(stderr, "Error sending Get-Printer-Attributes request: %s\n", cupsGetErrorString());
+    // Only the two attributes are decoded, straight off the connection; no ipp_t is built
+    ipp_stream_init(&response, requested_attrs, 2);
+    if (!ipp_stream_do_request(http, request, "/ipp/print", &response)) {
+        fprintf(stderr, "Error sending Get-Printer-Attributes request: %s\n", ipp_stream_error_string(&response));
         httpClose(http);
         ippDelete(request);
         return 1;
     }
 
-    status = ippGetStatusCode(response);
-
-    if (status > IPP_STATUS_OK_EVENTS_COMPLETE) {
-        fprintf(stderr, "Get-Printer-Attributes request failed: %s\n", cupsGetErrorString());
-        ippDelete(response);
+    if (response.status > IPP_STATUS_OK_EVENTS_COMPLETE) {
+        fprintf(stderr, "Get-Printer-Attributes request failed: %s\n", ipp_stream_error_string(&response));
         ippDelete(request);
         httpClose(http);
         return 1;
     }
 
-	print_octetstring_attribute(ippFindAttribute(response, "printer-alert", IPP_TAG_STRING), "printer-alert");
-	print_enum_attribute(ippFindAttribute(response, "printer-state", IPP_TAG_ENUM), "printer-state");
+	print_octetstring_attribute(ipp_stream_find(&response, "printer-alert"), "printer-alert");
+	print_enum_attribute(ipp_stream_find(&response, "printer-state"), "printer-state");
 
-    ippDelete(response);
     ippDelete(request);
     httpClose(http);
 
@@ -95,32 +129,24 @@ int main(int argc, char *argv[]) {
 }
 
 
-void print_octetstring_attribute(ipp_attribute_t *attr, const char *name) {
-    if (attr != NULL) {
-        int count = ippGetCount(attr);
+void print_octetstring_attribute(const IppStreamAttr *attr, const char *name) {
+    if (attr != NULL && attr->value_tag == IPP_TAG_STRING) {
+        int count = attr->num_values < IPP_STREAM_MAX_VALUES ? attr->num_values : IPP_STREAM_MAX_VALUES;
         printf("%s:\n", name);
         for (int i = 0; i < count; i++) {
-            size_t len = 0;
-            const char *value = (const char *)ippGetOctetString(attr, i, &len);
-
-            if (value != NULL) {
-                // Check to prevent crashes
-                printf("  %.*s\n", (int)len, value);
-            } else {
-                printf("  (null)\n");
-            }
+            printf("  %.*s\n", (int)attr->lengths[i], attr->strings[i]);
         }
     } else {
         printf("%s attribute not found in the response.\n", name);
     }
 }
 
-void print_enum_attribute(ipp_attribute_t *attr, const char *name) {
-    if (attr != NULL) {
-        int count = ippGetCount(attr);
+void print_enum_attribute(const IppStreamAttr *attr, const char *name) {
+    if (attr != NULL && attr->value_tag == IPP_TAG_ENUM) {
+        int count = attr->num_values < IPP_STREAM_MAX_VALUES ? attr->num_values : IPP_STREAM_MAX_VALUES;
         printf("%s:\n", name);
         for (int i = 0; i < count; i++) {
-        	ipp_pstate_t enum_value = ippGetInteger(attr, i);
+        	ipp_pstate_t enum_value = attr->integers[i];
 			const char *state_string = "unknown";
 
             //printer-state
@@ -142,3 +168,150 @@ void print_enum_attribute(ipp_attribute_t *attr, const char *name) {
         printf("%s attribute not found in the response.\n", name);
     }
 }
+
+// --- Function to time both ways of reading the response: full ipp_t tree vs. ipp-stream ---
+int run_benchmark(http_t *http, ipp_t *request, int iterations) {
+    const char *names[] = {"printer-alert", "printer-state"};
+    MemoryBuffer message = {NULL, 0, 0, 0};
+    IppStreamResponse parsed;
+    struct timespec start;
+    int found_tree = 0, found_stream = 0;
+
+    // Fetch the response once and keep its wire form, so both parsers see the same bytes
+    ipp_t *response = cupsDoRequest(http, request, "/ipp/print");
+    if (response == NULL) {
+        fprintf(stderr, "Error sending Get-Printer-Attributes request: %s\n", cupsGetErrorString());
+        return 1;
+    }
+    ippSetState(response, IPP_STATE_IDLE);
+    if (ippWriteIO(&message, memory_write, true, NULL, response) != IPP_STATE_DATA) {
+        fprintf(stderr, "Error: Unable to serialize the response.\n");
+        ippDelete(response);
+        free(message.data);
+        return 1;
+    }
+    ippDelete(response);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        ipp_t *tree = ippNew();
+        message.offset = 0;
+        if (ippReadIO(&message, memory_read, true, NULL, tree) == IPP_STATE_DATA) {
+            found_tree += ippFindAttribute(tree, "printer-alert", IPP_TAG_STRING) != NULL;
+            found_tree += ippFindAttribute(tree, "printer-state", IPP_TAG_ENUM) != NULL;
+        }
+        ippDelete(tree);
+    }
+    double tree_ns = elapsed_ns(&start) / iterations;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        ipp_stream_init(&parsed, names, 2);
+        if (ipp_stream_feed(&parsed, message.data, message.length)) {
+            found_stream += ipp_stream_find(&parsed, "printer-alert") != NULL;
+            found_stream += ipp_stream_find(&parsed, "printer-state") != NULL;
+        }
+    }
+    double stream_ns = elapsed_ns(&start) / iterations;
+
+    printf("Response: %zu bytes, %d iterations\n", message.length, iterations);
+    printf("  ipp_t:      %10.0f ns/response\n", tree_ns);
+    printf("  ipp-stream: %10.0f ns/response (%.1fx)\n", stream_ns, stream_ns > 0.0 ? tree_ns / stream_ns : 0.0);
+    free(message.data);
+
+    if (found_tree != found_stream) {
+        fprintf(stderr, "Error: Parsers disagree (%d vs. %d attributes found).\n", found_tree, found_stream);
+        return 1;
+    }
+    return 0;
+}
+
+// --- Function to append IPP bytes to a memory buffer (ipp_io_cb_t) ---
+ssize_t memory_write(void *context, ipp_uchar_t *buffer, size_t bytes) {
+    MemoryBuffer *mb = (MemoryBuffer *)context;
+    if (mb->length + bytes > mb->size) {
+        size_t size = mb->size ? mb->size * 2 : 4096;
+        while (size < mb->length + bytes) {
+            size *= 2;
+        }
+        ipp_uchar_t *data = realloc(mb->data, size);
+        if (!data) return -1;
+        mb->data = data;
+        mb->size = size;
+    }
+    memcpy(mb->data + mb->length, buffer, bytes);
+    mb->length += bytes;
+    return (ssize_t)bytes;
+}
+
+// --- Function to read IPP bytes back from a memory buffer (ipp_io_cb_t) ---
+ssize_t memory_read(void *context, ipp_uchar_t *buffer, size_t bytes) {
+    MemoryBuffer *mb = (MemoryBuffer *)context;
+    if (bytes > mb->length - mb->offset) {
+        bytes = mb->length - mb->offset;
+    }
+    memcpy(buffer, mb->data + mb->offset, bytes);
+    mb->offset += bytes;
+    return (ssize_t)bytes;
+}
+
+// --- Function to measure nanoseconds since start ---
+double elapsed_ns(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1e9 + (double)(now.tv_nsec - start->tv_nsec);
+}
+
+// --- Function to print a printer's state from the status-board shared memory, without network I/O ---
+int print_status_board(const char *hostname, int port) {
+    StatusEntry entry;
+    const StatusBoard *board = status_board_open(STATUS_BOARD_NAME);
+    if (!board) {
+        fprintf(stderr, "Error: No status board at %s; is status-board running?\n", STATUS_BOARD_NAME);
+        return 1;
+    }
+
+    bool found = status_board_read(board, hostname, port, &entry);
+    int interval = board->interval;
+    status_board_close(board);
+
+    if (!found) {
+        fprintf(stderr, "Error: %s:%d isn't on the status board.\n", hostname, port);
+        return 1;
+    }
+    if (entry.updated == 0) {
+        fprintf(stderr, "Error: No state for %s:%d yet%s%s.\n", hostname, port, entry.error[0] ? ": " : "", entry.error);
+        return 1;
+    }
+
+    // Same output as asking the printer, plus how old it is
+    if (entry.alerts[0]) {
+        printf("printer-alert:\n");
+        for (const char *line = entry.alerts; *line;) {
+            size_t length = strcspn(line, "\n");
+            printf("  %.*s\n", (int)length, line);
+            line += length + (line[length] == '\n');
+        }
+    } else {
+        printf("printer-alert attribute not found in the response.\n");
+    }
+
+    const char *state_string = "unknown";
+    switch (entry.state) {
+        case IPP_PSTATE_IDLE:  state_string = "Idle"; break;
+        case IPP_PSTATE_PROCESSING: state_string = "Processing"; break;
+        case IPP_PSTATE_STOPPED: state_string = "Stopped"; break;
+        default: break;
+    }
+    printf("printer-state:\n  %s\n", state_string);
+    printf("printer-state-reasons:\n  %s\n", entry.reasons[0] ? entry.reasons : "none");
+
+    long long age = (long long)(time(NULL) - entry.updated);
+    printf("last-update: %lld second%s ago\n", age, age == 1 ? "" : "s");
+    if (entry.failures > 0 && age > 2 * interval) {
+        fprintf(stderr, "Warning: State is stale, the last %d poll%s failed: %s\n", entry.failures,
+                entry.failures == 1 ? "" : "s", entry.error);
+    }
+
+    return 0;
+}
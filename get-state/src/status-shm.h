@@ -0,0 +1,65 @@
+#ifndef STATUS_SHM_H
+#define STATUS_SHM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Same module in status-board and get-state; keep the copies in sync
+
+#define STATUS_BOARD_NAME "/cups-demo-status"   // Default POSIX shared memory object
+#define STATUS_BOARD_MAGIC 0x42534443           // "CDSB"
+#define STATUS_BOARD_VERSION 1                  // Bump when the layout below changes
+#define STATUS_HOSTNAME_MAX 256
+#define STATUS_REASONS_MAX 256
+#define STATUS_ALERTS_MAX 512
+#define STATUS_ERROR_MAX 128
+
+// --- One printer's last known state ---
+// hostname and port are fixed before the board is marked ready. The rest is written only by
+// the poller; readers copy it and retry if the sequence was odd or changed meanwhile (a
+// seqlock), so they never block the poller or see a half-written entry.
+typedef struct {
+    _Atomic uint32_t sequence;
+    int32_t          port;
+    char             hostname[STATUS_HOSTNAME_MAX];
+    int32_t          state;                     // printer-state, 0 until the printer has answered once
+    int32_t          failures;                  // Polls failed in a row since the last good one
+    int64_t          updated;                   // time() of the last good poll, 0 for never
+    char             reasons[STATUS_REASONS_MAX];   // printer-state-reasons, comma separated
+    char             alerts[STATUS_ALERTS_MAX];     // printer-alert values, one per line
+    char             error[STATUS_ERROR_MAX];   // Why the last poll failed, empty if it didn't
+} StatusEntry;
+
+typedef struct {
+    _Atomic uint32_t magic;                     // Set last, by status_board_ready
+    uint32_t         version;
+    int32_t          num_printers;
+    int32_t          interval;                  // Poll interval in seconds, for judging staleness
+    int64_t          started;
+    StatusEntry      entries[];
+} StatusBoard;
+
+// Creates (or replaces) the board for num_printers printers; NULL on failure with errno set.
+// Fill in each entry's hostname and port, then call status_board_ready.
+StatusBoard *status_board_create(const char *name, int num_printers, int interval);
+
+// Lets readers use the board
+void status_board_ready(StatusBoard *board);
+
+// Removes the board's name, so readers can tell nobody is polling any more
+void status_board_remove(const char *name);
+
+// Maps an existing board read-only; NULL if there is none or its layout doesn't match
+const StatusBoard *status_board_open(const char *name);
+
+// Unmaps a board from either call
+void status_board_close(const StatusBoard *board);
+
+// Replaces an entry's state fields (state onwards) as one atomic update
+void status_board_publish(StatusEntry *entry, const StatusEntry *update);
+
+// Copies the entry for hostname:port into *copy; false if the board doesn't have that printer
+bool status_board_read(const StatusBoard *board, const char *hostname, int port, StatusEntry *copy);
+
+#endif
@@ -0,0 +1,946 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <libcups3/cups/cups.h>
+
+// --- Constants ---
+#define DEFAULT_PORT 8000
+#define DEFAULT_PROCESS_MS 500
+#define DEFAULT_QUEUE_DEPTH 100
+#define MAX_JOBS 1000               // Jobs kept for Get-Jobs; the oldest finished job is dropped first
+#define MAX_EVENTS 16
+#define RESOURCE_MAX 256
+#define JOB_NAME_MAX 128
+#define USER_NAME_MAX 64
+#define FORMAT_MAX 64
+#define DOCUMENT_BUFFER_SIZE 65536
+#define CLIENT_IDLE_MS 30000
+
+// --- Structures ---
+typedef enum {
+    EVENT_MEDIA_EMPTY,
+    EVENT_STOPPED
+} EventKind;
+
+// A scheduled state change: after_jobs completed jobs stop the printer for duration_ms (0 = for good)
+typedef struct {
+    EventKind kind;
+    int       after_jobs;
+    int       duration_ms;
+} StateEvent;
+
+typedef struct {
+    int         port;
+    int         process_ms;         // Engine time per job
+    int         queue_depth;        // Pending + processing jobs before Print-Job gets server-error-busy
+    int         delay_ms;           // Added before every response
+    double      error_rate;         // Fraction of requests answered with server-error-service-unavailable
+    double      drop_rate;          // Fraction of requests whose connection is closed without a response
+    uint64_t    seed;
+    StateEvent  events[MAX_EVENTS];
+    int         num_events;
+    bool        no_tls;
+    const char *keychain;
+    bool        verbose;
+} EmulatorConfig;
+
+typedef struct {
+    int          id;
+    ipp_jstate_t state;
+    char         name[JOB_NAME_MAX];
+    char         user[USER_NAME_MAX];
+    char         format[FORMAT_MAX];
+    size_t       bytes;
+    long long    created_ms;        // Emulator clock
+    long long    processing_ms;
+    long long    completed_ms;
+} EmulatedJob;
+
+// Everything below is guarded by lock; job states are worked out lazily from the clock
+typedef struct {
+    pthread_mutex_t lock;
+    ipp_t          *capabilities;   // Static printer attributes
+    EmulatedJob     jobs[MAX_JOBS]; // Ascending job-id
+    int             num_jobs;
+    int             next_job_id;
+    int             completed_count;
+    long long       free_at_ms;     // When the engine last became free
+    bool            stopped;
+    EventKind       stop_kind;
+    long long       stopped_until_ms;
+    bool            fired[MAX_EVENTS];
+    uint64_t        request_count;
+    int             darkness_configured;
+    int             darkness_default;
+    int             speed_default;
+} EmulatorState;
+
+// Set-Printer-Attributes can change these integers
+typedef struct {
+    const char *name;
+    int         lower;
+    int         upper;
+    size_t      offset;
+} SettableAttribute;
+
+static EmulatorConfig config;
+static EmulatorState state;
+static struct timespec start_time;
+
+static const SettableAttribute settable_attrs[] = {
+    {"printer-darkness-configured", 0, 100, offsetof(EmulatorState, darkness_configured)},
+    {"print-darkness-default", -100, 100, offsetof(EmulatorState, darkness_default)},
+    {"print-speed-default", 100, 1400, offsetof(EmulatorState, speed_default)}
+};
+
+// --- Function Prototypes ---
+bool parse_command_line(int argc, char *argv[]);
+bool parse_events(const char *list);
+ipp_t *create_capabilities(void);
+long long now_ms(void);
+double request_fraction(uint64_t request);
+void advance_printer(long long now);
+EmulatedJob *find_job(int job_id);
+int active_job_count(void);
+void *client_thread(void *arg);
+bool process_http(http_t *http);
+bool respond_http(http_t *http, http_status_t status, ipp_t *response);
+ipp_t *process_ipp(http_t *http, ipp_t *request, bool *drop);
+bool is_requested(ipp_attribute_t *requested, const char *name);
+void add_printer_attributes(ipp_t *response, ipp_attribute_t *requested, long long now);
+void add_job_attributes(ipp_t *response, const EmulatedJob *job, ipp_attribute_t *requested, const char *printer_uri);
+void do_print_job(http_t *http, ipp_t *request, ipp_t *response);
+void do_get_job_attributes(ipp_t *request, ipp_t *response);
+void do_get_jobs(ipp_t *request, ipp_t *response);
+void do_get_printer_attributes(ipp_t *request, ipp_t *response);
+void do_set_printer_attributes(ipp_t *request, ipp_t *response);
+
+int main(int argc, char *argv[]) {
+    config.port = DEFAULT_PORT;
+    config.process_ms = DEFAULT_PROCESS_MS;
+    config.queue_depth = DEFAULT_QUEUE_DEPTH;
+
+    // --- Parse command-line arguments ---
+    if (!parse_command_line(argc, argv)) {
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    pthread_mutex_init(&state.lock, NULL);
+    state.next_job_id = 1;
+    state.darkness_configured = 50;
+    state.speed_default = 500;
+    state.capabilities = create_capabilities();
+    if (!state.capabilities) {
+        fprintf(stderr, "Error: Unable to create printer attributes.\n");
+        return 1;
+    }
+
+    // A client that goes away mid-response must not take the emulator with it
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!config.no_tls && !cupsSetServerCredentials(config.keychain, "localhost", true)) {
+        fprintf(stderr, "Error: Unable to set up TLS credentials: %s\n", cupsGetErrorString());
+        return 1;
+    }
+
+    // --- Listen ---
+    char service[16];
+    snprintf(service, sizeof(service), "%d", config.port);
+    http_addrlist_t *addrlist = httpAddrGetList(NULL, AF_INET, service);
+    int listener = addrlist ? httpAddrListen(&addrlist->addr, config.port) : -1;
+    httpAddrFreeList(addrlist);
+    if (listener < 0) {
+        fprintf(stderr, "Error: Unable to listen on port %d: %s\n", config.port, cupsGetErrorString());
+        return 1;
+    }
+
+    printf("Emulating printer at ipp://localhost:%d/ipp/print (%s, %d ms/job, queue depth %d, delay %d ms, "
+           "errors %.1f%%, drops %.1f%%, seed %llu, %d scheduled state change%s)\n",
+           config.port, config.no_tls ? "no TLS" : "TLS", config.process_ms, config.queue_depth, config.delay_ms,
+           config.error_rate * 100.0, config.drop_rate * 100.0, (unsigned long long)config.seed,
+           config.num_events, config.num_events == 1 ? "" : "s");
+    fflush(stdout);
+
+    // --- Accept connections, one thread each ---
+    while (true) {
+        http_t *http = httpAcceptConnection(listener, true);
+        if (!http) {
+            fprintf(stderr, "Error: Unable to accept connection: %s\n", cupsGetErrorString());
+            continue;
+        }
+
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, client_thread, http) != 0) {
+            fprintf(stderr, "Error: Unable to start client thread.\n");
+            httpClose(http);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    return 0;
+}
+
+// --- Function to parse command-line arguments into config ---
+bool parse_command_line(int argc, char *argv[]) {
+    int opt;
+    opterr = 0;
+
+    while ((opt = getopt(argc, argv, "p:t:q:d:e:c:s:E:k:nv")) != -1) {
+        switch (opt) {
+            case 'p':
+                config.port = atoi(optarg);
+                break;
+            case 't':
+                config.process_ms = atoi(optarg);
+                break;
+            case 'q':
+                config.queue_depth = atoi(optarg);
+                break;
+            case 'd':
+                config.delay_ms = atoi(optarg);
+                break;
+            case 'e':
+                config.error_rate = atof(optarg) / 100.0;
+                break;
+            case 'c':
+                config.drop_rate = atof(optarg) / 100.0;
+                break;
+            case 's':
+                config.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'E':
+                if (!parse_events(optarg)) {
+                    return false;
+                }
+                break;
+            case 'k':
+                config.keychain = optarg;
+                break;
+            case 'n':
+                config.no_tls = true;
+                break;
+            case 'v':
+                config.verbose = true;
+                break;
+
+            case '?':
+                if (strchr("ptqdecsEk", optopt))
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+                else if (isprint(optopt))
+                    fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+                else
+                    fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    if (optind < argc || config.port <= 0 || config.process_ms < 0 || config.queue_depth < 1 || config.delay_ms < 0 ||
+        config.error_rate < 0.0 || config.drop_rate < 0.0 || config.error_rate + config.drop_rate > 1.0) {
+        fprintf(stderr, "Usage: %s [-p <port>] [-t <ms>] [-q <depth>] [-d <ms>] [-e <percent>] [-c <percent>] [-s <seed>] [-E <events>] [-k <keychain>] [-n] [-v]\n", argv[0]);
+        fprintf(stderr, "  -p <port>:      Port to listen on (optional, default is %d).\n", DEFAULT_PORT);
+        fprintf(stderr, "  -t <ms>:        Processing time per job (optional, default is %d).\n", DEFAULT_PROCESS_MS);
+        fprintf(stderr, "  -q <depth>:     Pending jobs accepted before Print-Job returns server-error-busy (optional, default is %d).\n", DEFAULT_QUEUE_DEPTH);
+        fprintf(stderr, "  -d <ms>:        Network delay added before every response (optional, default is 0).\n");
+        fprintf(stderr, "  -e <percent>:   Requests answered with server-error-service-unavailable (optional, default is 0).\n");
+        fprintf(stderr, "  -c <percent>:   Requests whose connection is dropped without a response (optional, default is 0).\n");
+        fprintf(stderr, "  -s <seed>:      Seed for -e and -c; the same seed and request order give the same faults (optional).\n");
+        fprintf(stderr, "  -E <events>:    State changes as kind@jobs[+ms], e.g. media-empty@20+3000,stopped@50; kind is\n");
+        fprintf(stderr, "                  media-empty or stopped, jobs is the completed job count, ms 0 or absent is forever.\n");
+        fprintf(stderr, "  -k <keychain>:  Directory for the self-signed TLS certificate (optional, libcups default).\n");
+        fprintf(stderr, "  -n:             Plain HTTP only; by default TLS is used when the client starts it.\n");
+        fprintf(stderr, "  -v:             Log each request to stderr.\n");
+        return false;
+    }
+
+    return true;
+}
+
+// --- Function to parse the -E list of scheduled state changes ---
+bool parse_events(const char *list) {
+    while (*list) {
+        if (config.num_events == MAX_EVENTS) {
+            fprintf(stderr, "Error: At most %d state changes can be scheduled.\n", MAX_EVENTS);
+            return false;
+        }
+
+        StateEvent *event = &config.events[config.num_events];
+        size_t length = strcspn(list, "@");
+        if (length == strlen("media-empty") && !strncmp(list, "media-empty", length)) {
+            event->kind = EVENT_MEDIA_EMPTY;
+        } else if (length == strlen("stopped") && !strncmp(list, "stopped", length)) {
+            event->kind = EVENT_STOPPED;
+        } else {
+            fprintf(stderr, "Error: Unknown state change \"%.*s\".\n", (int)length, list);
+            return false;
+        }
+        if (list[length] != '@') {
+            fprintf(stderr, "Error: State change needs a job count, e.g. media-empty@20.\n");
+            return false;
+        }
+
+        char *end;
+        event->after_jobs = (int)strtol(list + length + 1, &end, 10);
+        event->duration_ms = *end == '+' ? (int)strtol(end + 1, &end, 10) : 0;
+        if (event->after_jobs < 1 || event->duration_ms < 0 || (*end && *end != ',')) {
+            fprintf(stderr, "Error: Bad state change \"%s\".\n", list);
+            return false;
+        }
+
+        config.num_events++;
+        list = *end ? end + 1 : end;
+    }
+
+    return true;
+}
+
+// --- Function to build the static printer attributes of a 203/300 dpi label printer ---
+ipp_t *create_capabilities(void) {
+    ipp_t *caps = ippNew();
+    if (!caps) return NULL;
+
+    static const char * const formats[] = {
+        "application/octet-stream", "application/pdf", "application/vnd.zebra-zpl", "image/jpeg",
+        "image/png", "image/pwg-raster", "text/plain"
+    };
+    static const char * const compressions[] = {"none", "deflate", "gzip"};
+    static const char * const trackings[] = {"continuous", "gap", "mark"};
+    static const char * const settable[] = {"printer-darkness-configured", "print-darkness-default", "print-speed-default"};
+    static const int operations[] = {
+        IPP_OP_PRINT_JOB, IPP_OP_GET_JOB_ATTRIBUTES, IPP_OP_GET_JOBS, IPP_OP_GET_PRINTER_ATTRIBUTES,
+        IPP_OP_SET_PRINTER_ATTRIBUTES
+    };
+    static const int resolutions[] = {203, 300};
+    // 4x1", 4x6" and 2x1" labels; media-size is in hundredths of millimeters
+    static const int sizes[][2] = {{10160, 2540}, {10160, 15240}, {5080, 2540}};
+
+    ippAddString(caps, IPP_TAG_PRINTER, IPP_TAG_NAME, "printer-name", NULL, "ipp-emulator");
+    ippAddString(caps, IPP_TAG_PRINTER, IPP_TAG_TEXT, "printer-make-and-model", NULL, "cups-demo IPP Emulator");
+    ippAddString(caps, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "ipp-versions-supported", NULL, "2.0");
+    ippAddIntegers(caps, IPP_TAG_PRINTER, IPP_TAG_ENUM, "operations-supported",
+                   sizeof(operations) / sizeof(operations[0]), operations);
+    ippAddStrings(caps, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_MIMETYPE), "document-format-supported",
+                  sizeof(formats) / sizeof(formats[0]), NULL, formats);
+    ippAddString(caps, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_MIMETYPE), "document-format-default", NULL, "application/octet-stream");
+    ippAddStrings(caps, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "compression-supported",
+                  sizeof(compressions) / sizeof(compressions[0]), NULL, compressions);
+    ippAddStrings(caps, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-tracking-supported",
+                  sizeof(trackings) / sizeof(trackings[0]), NULL, trackings);
+    ippAddString(caps, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-tracking-default", NULL, "mark");
+    ippAddInteger(caps, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "print-darkness-supported", 101);
+    ippAddInteger(caps, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "printer-darkness-supported", 101);
+    ippAddRange(caps, IPP_TAG_PRINTER, "print-speed-supported", 100, 1400);
+    ippAddResolutions(caps, IPP_TAG_PRINTER, "printer-resolution-supported", 2, IPP_RES_PER_INCH, resolutions, resolutions);
+    ippAddResolution(caps, IPP_TAG_PRINTER, "printer-resolution-default", IPP_RES_PER_INCH, 203, 203);
+    ippAddStrings(caps, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "printer-settable-attributes-supported",
+                  sizeof(settable) / sizeof(settable[0]), NULL, settable);
+
+    // media-col-database: the fixed sizes plus a custom range
+    size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    ipp_t *media_cols[4], *media_sizes[4];
+    for (size_t i = 0; i <= num_sizes; i++) {
+        media_sizes[i] = ippNew();
+        if (i < num_sizes) {
+            ippAddInteger(media_sizes[i], IPP_TAG_ZERO, IPP_TAG_INTEGER, "x-dimension", sizes[i][0]);
+            ippAddInteger(media_sizes[i], IPP_TAG_ZERO, IPP_TAG_INTEGER, "y-dimension", sizes[i][1]);
+        } else {
+            ippAddRange(media_sizes[i], IPP_TAG_ZERO, "x-dimension", 2540, 10800);
+            ippAddRange(media_sizes[i], IPP_TAG_ZERO, "y-dimension", 635, 30480);
+        }
+        media_cols[i] = ippNew();
+        ippAddCollection(media_cols[i], IPP_TAG_ZERO, "media-size", media_sizes[i]);
+        ippAddString(media_cols[i], IPP_TAG_ZERO, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-type", NULL, "labels-continuous");
+        ippAddString(media_cols[i], IPP_TAG_ZERO, IPP_CONST_TAG(IPP_TAG_KEYWORD), "media-source", NULL, "main");
+    }
+    ippAddCollections(caps, IPP_TAG_PRINTER, "media-col-database", num_sizes + 1, (const ipp_t **)media_cols);
+    ippAddCollections(caps, IPP_TAG_PRINTER, "media-size-supported", num_sizes + 1, (const ipp_t **)media_sizes);
+    for (size_t i = 0; i <= num_sizes; i++) {
+        ippDelete(media_cols[i]);
+        ippDelete(media_sizes[i]);
+    }
+
+    return caps;
+}
+
+// --- Function to read the emulator clock, milliseconds since startup ---
+long long now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)(now.tv_sec - start_time.tv_sec) * 1000 + (now.tv_nsec - start_time.tv_nsec) / 1000000;
+}
+
+// --- Function to map a request number to a fraction in [0, 1), fixed for a given seed (splitmix64) ---
+double request_fraction(uint64_t request) {
+    uint64_t x = config.seed + request * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (double)(x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// --- Function to run the engine up to now: one job at a time, oldest first ---
+// Scheduled state changes fire on completed job counts, so the timeline depends only on
+// when jobs arrived, not on when anyone happened to ask.
+void advance_printer(long long now) {
+    while (true) {
+        if (state.stopped) {
+            if (now < state.stopped_until_ms) {
+                return;
+            }
+            state.stopped = false;
+            state.free_at_ms = state.stopped_until_ms;
+        }
+
+        EmulatedJob *job = NULL;
+        for (int i = 0; i < state.num_jobs && !job; i++) {
+            if (state.jobs[i].state == IPP_JSTATE_PENDING || state.jobs[i].state == IPP_JSTATE_PROCESSING) {
+                job = &state.jobs[i];
+            }
+        }
+        if (!job) {
+            return;
+        }
+
+        if (job->state == IPP_JSTATE_PENDING) {
+            job->state = IPP_JSTATE_PROCESSING;
+            job->processing_ms = job->created_ms > state.free_at_ms ? job->created_ms : state.free_at_ms;
+            job->completed_ms = job->processing_ms + config.process_ms;
+        }
+        if (now < job->completed_ms) {
+            return;
+        }
+
+        job->state = IPP_JSTATE_COMPLETED;
+        state.free_at_ms = job->completed_ms;
+        state.completed_count++;
+
+        for (int i = 0; i < config.num_events; i++) {
+            if (!state.fired[i] && state.completed_count >= config.events[i].after_jobs) {
+                state.fired[i] = true;
+                state.stopped = true;
+                state.stop_kind = config.events[i].kind;
+                state.stopped_until_ms = config.events[i].duration_ms > 0 ?
+                                         job->completed_ms + config.events[i].duration_ms : LLONG_MAX;
+                break;
+            }
+        }
+    }
+}
+
+// --- Function to look up a job by ID; jobs are kept in ID order ---
+EmulatedJob *find_job(int job_id) {
+    int low = 0, high = state.num_jobs - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (state.jobs[mid].id == job_id) {
+            return &state.jobs[mid];
+        } else if (state.jobs[mid].id < job_id) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+// --- Function to count jobs the engine still has to finish ---
+int active_job_count(void) {
+    int count = 0;
+    for (int i = 0; i < state.num_jobs; i++) {
+        if (state.jobs[i].state == IPP_JSTATE_PENDING || state.jobs[i].state == IPP_JSTATE_PROCESSING) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// --- Client thread: serve requests on one connection until it closes or goes idle ---
+void *client_thread(void *arg) {
+    http_t *http = (http_t *)arg;
+
+    // Start TLS if the client's first byte is a TLS handshake record
+    if (!config.no_tls) {
+        unsigned char first;
+        if (recv(httpGetFd(http), &first, 1, MSG_PEEK) == 1 && first == 0x16 &&
+            !httpSetEncryption(http, HTTP_ENCRYPTION_ALWAYS)) {
+            fprintf(stderr, "Error: TLS handshake failed: %s\n", cupsGetErrorString());
+            httpClose(http);
+            return NULL;
+        }
+    }
+
+    while (httpWait(http, CLIENT_IDLE_MS)) {
+        if (!process_http(http)) {
+            break;
+        }
+    }
+
+    httpClose(http);
+    return NULL;
+}
+
+// --- Function to handle one HTTP request; false closes the connection ---
+bool process_http(http_t *http) {
+    char resource[RESOURCE_MAX];
+    http_state_t http_state = httpReadRequest(http, resource, sizeof(resource));
+
+    if (http_state == HTTP_STATE_WAITING) {
+        return true;
+    } else if (http_state == HTTP_STATE_ERROR || http_state == HTTP_STATE_UNKNOWN_METHOD ||
+               http_state == HTTP_STATE_UNKNOWN_VERSION) {
+        return false;
+    }
+
+    http_status_t status;
+    while ((status = httpUpdate(http)) == HTTP_STATUS_CONTINUE);
+    if (status != HTTP_STATUS_OK) {
+        respond_http(http, HTTP_STATUS_BAD_REQUEST, NULL);
+        return false;
+    }
+
+    // Only IPP over POST; anything else gets an error and the connection is closed
+    const char *content_type = httpGetField(http, HTTP_FIELD_CONTENT_TYPE);
+    if (http_state != HTTP_STATE_POST) {
+        respond_http(http, HTTP_STATUS_METHOD_NOT_ALLOWED, NULL);
+        return false;
+    }
+    if (!content_type || strcasecmp(content_type, "application/ipp")) {
+        respond_http(http, HTTP_STATUS_BAD_REQUEST, NULL);
+        return false;
+    }
+
+    const char *expect = httpGetField(http, HTTP_FIELD_EXPECT);
+    if (expect && !strcasecmp(expect, "100-continue") && !respond_http(http, HTTP_STATUS_CONTINUE, NULL)) {
+        return false;
+    }
+
+    ipp_t *request = ippNew();
+    ipp_state_t ipp_state;
+    while ((ipp_state = ippRead(http, request)) != IPP_STATE_DATA) {
+        if (ipp_state == IPP_STATE_ERROR) {
+            ippDelete(request);
+            respond_http(http, HTTP_STATUS_BAD_REQUEST, NULL);
+            return false;
+        }
+    }
+
+    bool drop = false;
+    ipp_t *response = process_ipp(http, request, &drop);
+
+    // Whatever the operation didn't read (e.g. a rejected document) has to be consumed
+    char discard[DOCUMENT_BUFFER_SIZE];
+    while (httpRead(http, discard, sizeof(discard)) > 0);
+
+    bool ok = false;
+    if (!drop) {
+        if (config.delay_ms > 0) {
+            usleep((useconds_t)config.delay_ms * 1000);
+        }
+        ok = respond_http(http, HTTP_STATUS_OK, response);
+    }
+
+    ippDelete(response);
+    ippDelete(request);
+    return ok;
+}
+
+// --- Function to send an HTTP status, with an IPP message body if given ---
+bool respond_http(http_t *http, http_status_t status, ipp_t *response) {
+    if (status == HTTP_STATUS_CONTINUE) {
+        return httpWriteResponse(http, HTTP_STATUS_CONTINUE);
+    }
+
+    httpClearFields(http);
+    if (response) {
+        httpSetField(http, HTTP_FIELD_CONTENT_TYPE, "application/ipp");
+        httpSetLength(http, ippLength(response));
+    } else {
+        httpSetLength(http, 0);
+    }
+
+    if (!httpWriteResponse(http, status)) {
+        return false;
+    }
+    if (response) {
+        ippSetState(response, IPP_STATE_IDLE);
+        if (ippWrite(http, response) != IPP_STATE_DATA) {
+            return false;
+        }
+    }
+
+    return httpFlushWrite(http);
+}
+
+// --- Function to run one IPP operation and build its response ---
+ipp_t *process_ipp(http_t *http, ipp_t *request, bool *drop) {
+    ipp_t *response = ippNewResponse(request);
+    ipp_op_t op = ippGetOperation(request);
+
+    pthread_mutex_lock(&state.lock);
+    uint64_t request_number = ++state.request_count;
+    pthread_mutex_unlock(&state.lock);
+
+    // Injected faults come first, so they hit every operation alike
+    double fraction = request_fraction(request_number);
+    if (fraction < config.drop_rate) {
+        *drop = true;
+    } else if (fraction < config.drop_rate + config.error_rate) {
+        ippSetStatusCode(response, IPP_STATUS_ERROR_SERVICE_UNAVAILABLE);
+    } else {
+        switch (op) {
+            case IPP_OP_PRINT_JOB:
+                do_print_job(http, request, response);
+                break;
+            case IPP_OP_GET_JOB_ATTRIBUTES:
+                do_get_job_attributes(request, response);
+                break;
+            case IPP_OP_GET_JOBS:
+                do_get_jobs(request, response);
+                break;
+            case IPP_OP_GET_PRINTER_ATTRIBUTES:
+                do_get_printer_attributes(request, response);
+                break;
+            case IPP_OP_SET_PRINTER_ATTRIBUTES:
+                do_set_printer_attributes(request, response);
+                break;
+            default:
+                ippSetStatusCode(response, IPP_STATUS_ERROR_OPERATION_NOT_SUPPORTED);
+                break;
+        }
+    }
+
+    if (config.verbose) {
+        fprintf(stderr, "#%llu %s: %s\n", (unsigned long long)request_number, ippOpString(op),
+                *drop ? "dropped" : ippErrorString(ippGetStatusCode(response)));
+    }
+
+    return response;
+}
+
+// --- Function to tell whether requested-attributes asks for name (no list means everything) ---
+bool is_requested(ipp_attribute_t *requested, const char *name) {
+    return !requested || ippContainsString(requested, "all") || ippContainsString(requested, name) ||
+           ippContainsString(requested, "printer-description") || ippContainsString(requested, "job-description");
+}
+
+// --- Function to add printer attributes; call with the lock held ---
+void add_printer_attributes(ipp_t *response, ipp_attribute_t *requested, long long now) {
+    for (ipp_attribute_t *attr = ippGetFirstAttribute(state.capabilities); attr; attr = ippGetNextAttribute(state.capabilities)) {
+        if (is_requested(requested, ippGetName(attr))) {
+            ippCopyAttribute(response, attr, true);
+        }
+    }
+
+    bool processing = false;
+    for (int i = 0; i < state.num_jobs && !processing; i++) {
+        processing = state.jobs[i].state == IPP_JSTATE_PROCESSING;
+    }
+
+    if (is_requested(requested, "printer-state")) {
+        ippAddInteger(response, IPP_TAG_PRINTER, IPP_TAG_ENUM, "printer-state",
+                      state.stopped ? IPP_PSTATE_STOPPED : processing ? IPP_PSTATE_PROCESSING : IPP_PSTATE_IDLE);
+    }
+    if (is_requested(requested, "printer-state-reasons")) {
+        const char *reason = !state.stopped ? "none" : state.stop_kind == EVENT_MEDIA_EMPTY ? "media-empty-error" : "paused";
+        ippAddString(response, IPP_TAG_PRINTER, IPP_CONST_TAG(IPP_TAG_KEYWORD), "printer-state-reasons", NULL, reason);
+    }
+    if (is_requested(requested, "printer-alert")) {
+        const char *alert = state.stopped && state.stop_kind == EVENT_MEDIA_EMPTY ?
+                            "code=mediaEmpty;severity=critical;group=mediaInput" : "code=other;severity=other;group=other";
+        ippAddOctetString(response, IPP_TAG_PRINTER, "printer-alert", alert, strlen(alert));
+    }
+    if (is_requested(requested, "printer-is-accepting-jobs")) {
+        ippAddBoolean(response, IPP_TAG_PRINTER, "printer-is-accepting-jobs", true);
+    }
+    if (is_requested(requested, "printer-up-time")) {
+        ippAddInteger(response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "printer-up-time", (int)(now / 1000) + 1);
+    }
+    if (is_requested(requested, "queued-job-count")) {
+        ippAddInteger(response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "queued-job-count", active_job_count());
+    }
+
+    for (size_t i = 0; i < sizeof(settable_attrs) / sizeof(settable_attrs[0]); i++) {
+        if (is_requested(requested, settable_attrs[i].name)) {
+            ippAddInteger(response, IPP_TAG_PRINTER, IPP_TAG_INTEGER, settable_attrs[i].name,
+                          *(int *)((char *)&state + settable_attrs[i].offset));
+        }
+    }
+}
+
+// --- Function to add one job's attributes; call with the lock held ---
+void add_job_attributes(ipp_t *response, const EmulatedJob *job, ipp_attribute_t *requested, const char *printer_uri) {
+    if (is_requested(requested, "job-id")) {
+        ippAddInteger(response, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-id", job->id);
+    }
+    if (is_requested(requested, "job-uri")) {
+        char job_uri[RESOURCE_MAX + 16];
+        snprintf(job_uri, sizeof(job_uri), "%s/%d", printer_uri ? printer_uri : "ipp://localhost/ipp/print", job->id);
+        ippAddString(response, IPP_TAG_JOB, IPP_TAG_URI, "job-uri", NULL, job_uri);
+    }
+    if (is_requested(requested, "job-state")) {
+        ippAddInteger(response, IPP_TAG_JOB, IPP_TAG_ENUM, "job-state", job->state);
+    }
+    if (is_requested(requested, "job-state-reasons")) {
+        const char *reason = job->state == IPP_JSTATE_COMPLETED ? "job-completed-successfully" :
+                             job->state == IPP_JSTATE_PROCESSING ? "job-printing" :
+                             state.stopped ? "printer-stopped" : "job-queued";
+        ippAddString(response, IPP_TAG_JOB, IPP_CONST_TAG(IPP_TAG_KEYWORD), "job-state-reasons", NULL, reason);
+    }
+    if (is_requested(requested, "job-name")) {
+        ippAddString(response, IPP_TAG_JOB, IPP_TAG_NAME, "job-name", NULL, job->name);
+    }
+    if (is_requested(requested, "job-originating-user-name")) {
+        ippAddString(response, IPP_TAG_JOB, IPP_TAG_NAME, "job-originating-user-name", NULL, job->user);
+    }
+    if (is_requested(requested, "document-format")) {
+        ippAddString(response, IPP_TAG_JOB, IPP_TAG_MIMETYPE, "document-format", NULL, job->format);
+    }
+    if (is_requested(requested, "job-k-octets")) {
+        ippAddInteger(response, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-k-octets", (int)((job->bytes + 1023) / 1024));
+    }
+
+    // Times are printer-up-time seconds, as the spec has it
+    if (is_requested(requested, "time-at-creation")) {
+        ippAddInteger(response, IPP_TAG_JOB, IPP_TAG_INTEGER, "time-at-creation", (int)(job->created_ms / 1000) + 1);
+    }
+    if (is_requested(requested, "time-at-processing")) {
+        if (job->state >= IPP_JSTATE_PROCESSING) {
+            ippAddInteger(response, IPP_TAG_JOB, IPP_TAG_INTEGER, "time-at-processing", (int)(job->processing_ms / 1000) + 1);
+        } else {
+            ippAddOutOfBand(response, IPP_TAG_JOB, IPP_TAG_NOVALUE, "time-at-processing");
+        }
+    }
+    if (is_requested(requested, "time-at-completed")) {
+        if (job->state == IPP_JSTATE_COMPLETED) {
+            ippAddInteger(response, IPP_TAG_JOB, IPP_TAG_INTEGER, "time-at-completed", (int)(job->completed_ms / 1000) + 1);
+        } else {
+            ippAddOutOfBand(response, IPP_TAG_JOB, IPP_TAG_NOVALUE, "time-at-completed");
+        }
+    }
+    if (is_requested(requested, "job-printer-up-time")) {
+        ippAddInteger(response, IPP_TAG_JOB, IPP_TAG_INTEGER, "job-printer-up-time", (int)(now_ms() / 1000) + 1);
+    }
+}
+
+// --- Print-Job: read the whole document, then queue it ---
+void do_print_job(http_t *http, ipp_t *request, ipp_t *response) {
+    const char *format = ippGetString(ippFindAttribute(request, "document-format", IPP_TAG_MIMETYPE), 0, NULL);
+    const char *compression = ippGetString(ippFindAttribute(request, "compression", IPP_TAG_KEYWORD), 0, NULL);
+    const char *name = ippGetString(ippFindAttribute(request, "job-name", IPP_TAG_NAME), 0, NULL);
+    const char *user = ippGetString(ippFindAttribute(request, "requesting-user-name", IPP_TAG_NAME), 0, NULL);
+    const char *printer_uri = ippGetString(ippFindAttribute(request, "printer-uri", IPP_TAG_URI), 0, NULL);
+
+    if (!format) {
+        format = "application/octet-stream";
+    }
+
+    pthread_mutex_lock(&state.lock);
+    bool format_ok = ippContainsString(ippFindAttribute(state.capabilities, "document-format-supported", IPP_TAG_MIMETYPE), format);
+    bool compression_ok = !compression || ippContainsString(ippFindAttribute(state.capabilities, "compression-supported", IPP_TAG_KEYWORD), compression);
+    pthread_mutex_unlock(&state.lock);
+
+    if (!format_ok) {
+        ippSetStatusCode(response, IPP_STATUS_ERROR_DOCUMENT_FORMAT_NOT_SUPPORTED);
+        return;
+    }
+    if (!compression_ok) {
+        ippSetStatusCode(response, IPP_STATUS_ERROR_COMPRESSION_NOT_SUPPORTED);
+        return;
+    }
+
+    // The document is counted, not kept
+    char buffer[DOCUMENT_BUFFER_SIZE];
+    size_t bytes = 0;
+    ssize_t length;
+    while ((length = httpRead(http, buffer, sizeof(buffer))) > 0) {
+        bytes += (size_t)length;
+    }
+    if (length < 0) {
+        ippSetStatusCode(response, IPP_STATUS_ERROR_DOCUMENT_ACCESS);
+        return;
+    }
+
+    pthread_mutex_lock(&state.lock);
+    long long now = now_ms();
+    advance_printer(now);
+
+    if (active_job_count() >= config.queue_depth) {
+        pthread_mutex_unlock(&state.lock);
+        ippSetStatusCode(response, IPP_STATUS_ERROR_BUSY);
+        return;
+    }
+
+    // Make room by forgetting the oldest finished job
+    if (state.num_jobs == MAX_JOBS) {
+        int oldest = 0;
+        while (oldest < state.num_jobs && state.jobs[oldest].state < IPP_JSTATE_CANCELED) {
+            oldest++;
+        }
+        if (oldest == state.num_jobs) {
+            pthread_mutex_unlock(&state.lock);
+            ippSetStatusCode(response, IPP_STATUS_ERROR_BUSY);
+            return;
+        }
+        memmove(&state.jobs[oldest], &state.jobs[oldest + 1], (size_t)(state.num_jobs - oldest - 1) * sizeof(EmulatedJob));
+        state.num_jobs--;
+    }
+
+    EmulatedJob *job = &state.jobs[state.num_jobs++];
+    memset(job, 0, sizeof(*job));
+    job->id = state.next_job_id++;
+    job->state = IPP_JSTATE_PENDING;
+    job->created_ms = now;
+    job->bytes = bytes;
+    snprintf(job->name, sizeof(job->name), "%s", name ? name : "Untitled");
+    snprintf(job->user, sizeof(job->user), "%s", user ? user : "anonymous");
+    snprintf(job->format, sizeof(job->format), "%s", format);
+    advance_printer(now);
+
+    static const char * const job_attrs[] = {"job-id", "job-uri", "job-state", "job-state-reasons"};
+    ipp_t *filter = ippNew();
+    ipp_attribute_t *requested = ippAddStrings(filter, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD),
+                                               "requested-attributes", 4, NULL, job_attrs);
+    add_job_attributes(response, job, requested, printer_uri);
+    pthread_mutex_unlock(&state.lock);
+    ippDelete(filter);
+
+    ippSetStatusCode(response, IPP_STATUS_OK);
+}
+
+// --- Get-Job-Attributes ---
+void do_get_job_attributes(ipp_t *request, ipp_t *response) {
+    ipp_attribute_t *job_id = ippFindAttribute(request, "job-id", IPP_TAG_INTEGER);
+    ipp_attribute_t *requested = ippFindAttribute(request, "requested-attributes", IPP_TAG_KEYWORD);
+    const char *printer_uri = ippGetString(ippFindAttribute(request, "printer-uri", IPP_TAG_URI), 0, NULL);
+
+    if (!job_id) {
+        ippSetStatusCode(response, IPP_STATUS_ERROR_BAD_REQUEST);
+        return;
+    }
+
+    pthread_mutex_lock(&state.lock);
+    advance_printer(now_ms());
+    EmulatedJob *job = find_job(ippGetInteger(job_id, 0));
+    if (job) {
+        add_job_attributes(response, job, requested, printer_uri);
+    }
+    pthread_mutex_unlock(&state.lock);
+
+    ippSetStatusCode(response, job ? IPP_STATUS_OK : IPP_STATUS_ERROR_NOT_FOUND);
+}
+
+// --- Get-Jobs: which-jobs, my-jobs and limit are honored ---
+void do_get_jobs(ipp_t *request, ipp_t *response) {
+    const char *which = ippGetString(ippFindAttribute(request, "which-jobs", IPP_TAG_KEYWORD), 0, NULL);
+    ipp_attribute_t *my_jobs = ippFindAttribute(request, "my-jobs", IPP_TAG_BOOLEAN);
+    ipp_attribute_t *limit_attr = ippFindAttribute(request, "limit", IPP_TAG_INTEGER);
+    ipp_attribute_t *requested = ippFindAttribute(request, "requested-attributes", IPP_TAG_KEYWORD);
+    const char *user = ippGetString(ippFindAttribute(request, "requesting-user-name", IPP_TAG_NAME), 0, NULL);
+    const char *printer_uri = ippGetString(ippFindAttribute(request, "printer-uri", IPP_TAG_URI), 0, NULL);
+    int limit = limit_attr ? ippGetInteger(limit_attr, 0) : INT_MAX;
+
+    bool completed = false, all = false;
+    if (which && !strcmp(which, "completed")) {
+        completed = true;
+    } else if (which && !strcmp(which, "all")) {
+        all = true;
+    } else if (which && strcmp(which, "not-completed")) {
+        ippSetStatusCode(response, IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES);
+        return;
+    }
+
+    pthread_mutex_lock(&state.lock);
+    advance_printer(now_ms());
+
+    int count = 0;
+    for (int i = 0; i < state.num_jobs && count < limit; i++) {
+        const EmulatedJob *job = &state.jobs[i];
+        if (!all && (job->state >= IPP_JSTATE_CANCELED) != completed) {
+            continue;
+        }
+        if (my_jobs && ippGetBoolean(my_jobs, 0) && (!user || strcmp(user, job->user))) {
+            continue;
+        }
+
+        if (count++ > 0) {
+            ippAddSeparator(response);
+        }
+        add_job_attributes(response, job, requested, printer_uri);
+    }
+    pthread_mutex_unlock(&state.lock);
+
+    ippSetStatusCode(response, IPP_STATUS_OK);
+}
+
+// --- Get-Printer-Attributes ---
+void do_get_printer_attributes(ipp_t *request, ipp_t *response) {
+    ipp_attribute_t *requested = ippFindAttribute(request, "requested-attributes", IPP_TAG_KEYWORD);
+
+    pthread_mutex_lock(&state.lock);
+    long long now = now_ms();
+    advance_printer(now);
+    add_printer_attributes(response, requested, now);
+    pthread_mutex_unlock(&state.lock);
+
+    ippSetStatusCode(response, IPP_STATUS_OK);
+}
+
+// --- Set-Printer-Attributes: all or nothing over the settable integers ---
+void do_set_printer_attributes(ipp_t *request, ipp_t *response) {
+    int values[sizeof(settable_attrs) / sizeof(settable_attrs[0])];
+    bool set[sizeof(settable_attrs) / sizeof(settable_attrs[0])] = {false};
+    bool unsupported = false;
+
+    for (ipp_attribute_t *attr = ippGetFirstAttribute(request); attr; attr = ippGetNextAttribute(request)) {
+        if (ippGetGroupTag(attr) != IPP_TAG_PRINTER || !ippGetName(attr)) {
+            continue;
+        }
+
+        bool ok = false;
+        for (size_t i = 0; i < sizeof(settable_attrs) / sizeof(settable_attrs[0]) && !ok; i++) {
+            if (!strcmp(ippGetName(attr), settable_attrs[i].name) && ippGetValueTag(attr) == IPP_TAG_INTEGER &&
+                ippGetCount(attr) == 1) {
+                int value = ippGetInteger(attr, 0);
+                if (value >= settable_attrs[i].lower && value <= settable_attrs[i].upper) {
+                    values[i] = value;
+                    set[i] = ok = true;
+                }
+            }
+        }
+
+        if (!ok) {
+            ipp_attribute_t *copy = ippCopyAttribute(response, attr, false);
+            ippSetGroupTag(response, &copy, IPP_TAG_UNSUPPORTED_GROUP);
+            unsupported = true;
+        }
+    }
+
+    if (unsupported) {
+        ippSetStatusCode(response, IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES);
+        return;
+    }
+
+    pthread_mutex_lock(&state.lock);
+    for (size_t i = 0; i < sizeof(settable_attrs) / sizeof(settable_attrs[0]); i++) {
+        if (set[i]) {
+            *(int *)((char *)&state + settable_attrs[i].offset) = values[i];
+        }
+    }
+    pthread_mutex_unlock(&state.lock);
+
+    ippSetStatusCode(response, IPP_STATUS_OK);
+}
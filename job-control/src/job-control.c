@@ -0,0 +1,727 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <libcups3/cups/cups.h>
+
+// --- Constants ---
+#define PRINTER_URI_MAX 256
+#define CREDENTIALS_MAX 256
+#define HOSTNAME_MAX 256
+#define DEFAULT_PORT 631
+#define MAX_PRINTERS 256
+#define FALLBACK_WORKERS 8      // Connections per printer used for per-job requests
+#define JOB_IDS_MAX 1000        // Most jobs acted on per printer in one run
+
+// Job states a selection can name, as bits of (1 << job-state)
+#define STATE_BIT(state) (1u << (state))
+#define ACTIVE_STATES (STATE_BIT(IPP_JSTATE_PENDING) | STATE_BIT(IPP_JSTATE_HELD) | \
+                       STATE_BIT(IPP_JSTATE_PROCESSING) | STATE_BIT(IPP_JSTATE_STOPPED))
+
+// --- Structures ---
+typedef enum {
+    ACTION_CANCEL,              // Cancel the selected jobs
+    ACTION_PURGE,               // Cancel every job on the printer
+    ACTION_HOLD,                // Hold new jobs as they arrive
+    ACTION_RELEASE              // Release jobs held by hold
+} JobAction;
+
+// Batch operation for each action, and the per-job operation used where it is unsupported.
+// Hold-New-Jobs and Release-Held-New-Jobs only concern jobs yet to arrive, so no per-job
+// operation means the same thing; those actions have no job_op and never list jobs.
+typedef struct {
+    const char *name;
+    ipp_op_t    batch_op;
+    const char *batch_name;
+    const char *batch_effect;   // What the batch operation does, for -n
+    ipp_op_t    job_op;
+    const char *job_name;       // NULL if there is no per-job fallback
+    unsigned    job_states;     // States the per-job operation applies to
+} ActionInfo;
+
+typedef struct {
+    char        hostname[HOSTNAME_MAX];
+    int         port;
+} PrinterAddress;
+
+typedef struct {
+    PrinterAddress printers[MAX_PRINTERS];
+    int            num_printers;
+    int            port;
+    JobAction      action;
+    const char    *owner;       // job-originating-user-name, NULL for anyone
+    int            min_age;     // Seconds since creation, 0 for any age
+    unsigned       states;      // STATE_BIT mask, 0 for any active state
+    bool           dry_run;
+    const char    *username;
+    const char    *password;
+    bool           use_auth;
+} JobControlParams;
+
+// One printer's share of the run; filled in by its thread, reported by main
+typedef struct {
+    const JobControlParams *params;
+    const PrinterAddress   *printer;
+    char                    printer_uri[PRINTER_URI_MAX];
+    const char             *method;         // Operation that did the work
+    int                     job_ids[JOB_IDS_MAX];
+    int                     num_jobs;
+    bool                    all_jobs;       // Batch operation without a job list
+    int                     succeeded;
+    int                     failed;
+    int                     round_trips;
+    char                    error[256];
+} PrinterTask;
+
+// Per-job requests shared out between FALLBACK_WORKERS connections
+typedef struct {
+    PrinterTask    *task;
+    ipp_op_t        op;
+    int             next;
+    pthread_mutex_t lock;
+} JobFanout;
+
+static const ActionInfo action_info[] = {
+    [ACTION_CANCEL]  = {"cancel", IPP_OP_CANCEL_JOBS, "Cancel-Jobs", "cancel", IPP_OP_CANCEL_JOB, "Cancel-Job", ACTIVE_STATES},
+    [ACTION_PURGE]   = {"purge", IPP_OP_CANCEL_JOBS, "Cancel-Jobs", "cancel", IPP_OP_CANCEL_JOB, "Cancel-Job", ACTIVE_STATES},
+    [ACTION_HOLD]    = {"hold", IPP_OP_HOLD_NEW_JOBS, "Hold-New-Jobs", "hold every job submitted from now on", IPP_OP_CUPS_NONE, NULL, 0},
+    [ACTION_RELEASE] = {"release", IPP_OP_RELEASE_HELD_NEW_JOBS, "Release-Held-New-Jobs", "release the jobs held by hold", IPP_OP_CUPS_NONE, NULL, 0}
+};
+
+// --- Function Prototypes ---
+char *base64Encoder(const char *data, size_t input_length);
+bool parse_command_line(int argc, char *argv[], JobControlParams *params);
+bool add_printer(JobControlParams *params, const char *address);
+bool load_printer_list(JobControlParams *params, const char *filename);
+bool parse_states(const char *list, unsigned *states);
+http_t *establish_ipp_connection(const char *hostname, int port);
+bool handle_authentication(http_t *http, const char *username, const char *password);
+bool owner_is_me(const JobControlParams *params);
+ipp_op_t batch_operation(const JobControlParams *params, const char **name);
+bool list_jobs(http_t *http, PrinterTask *task, unsigned job_states);
+ipp_status_t do_batch_operation(http_t *http, PrinterTask *task);
+void *printer_worker(void *arg);
+void *job_worker(void *arg);
+void run_per_job(PrinterTask *task, ipp_op_t op);
+
+int main(int argc, char *argv[]) {
+    static JobControlParams params;
+    params.port = DEFAULT_PORT;
+
+    // --- Parse command-line arguments ---
+    if (!parse_command_line(argc, argv, &params)) {
+        return 1;
+    }
+
+    // --- One thread per printer, so the whole line takes about as long as its slowest printer ---
+    PrinterTask *tasks = calloc((size_t)params.num_printers, sizeof(PrinterTask));
+    pthread_t *threads = calloc((size_t)params.num_printers, sizeof(pthread_t));
+    bool *started = calloc((size_t)params.num_printers, sizeof(bool));
+    if (!tasks || !threads || !started) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        free(started);
+        free(threads);
+        free(tasks);
+        return 1;
+    }
+
+    for (int i = 0; i < params.num_printers; i++) {
+        tasks[i].params = &params;
+        tasks[i].printer = &params.printers[i];
+        snprintf(tasks[i].printer_uri, sizeof(tasks[i].printer_uri), "ipp://%s:%d/ipp/print",
+                 params.printers[i].hostname, params.printers[i].port);
+
+        if (pthread_create(&threads[i], NULL, printer_worker, &tasks[i]) == 0) {
+            started[i] = true;
+        } else {
+            snprintf(tasks[i].error, sizeof(tasks[i].error), "unable to start thread");
+        }
+    }
+
+    // --- Report in command-line order once every printer is done ---
+    int failures = 0;
+    for (int i = 0; i < params.num_printers; i++) {
+        PrinterTask *task = &tasks[i];
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+
+        printf("%s:%d: ", task->printer->hostname, task->printer->port);
+        if (task->error[0]) {
+            printf("failed: %s\n", task->error);
+            failures++;
+        } else if (params.dry_run && task->all_jobs) {
+            printf("%s would %s\n", task->method, action_info[params.action].batch_effect);
+        } else if (params.dry_run) {
+            printf("%s would %s %d job(s):", task->method, action_info[params.action].batch_effect, task->num_jobs);
+            for (int j = 0; j < task->num_jobs; j++) {
+                printf(" %d", task->job_ids[j]);
+            }
+            printf("\n");
+        } else if (!task->method) {
+            printf("no matching jobs\n");
+        } else if (task->all_jobs) {
+            printf("%s done (%d round trip%s)\n", task->method, task->round_trips, task->round_trips == 1 ? "" : "s");
+        } else {
+            printf("%s done for %d of %d job(s) (%d round trip%s)\n", task->method, task->succeeded,
+                   task->num_jobs, task->round_trips, task->round_trips == 1 ? "" : "s");
+            if (task->failed > 0) {
+                failures++;
+            }
+        }
+    }
+
+    free(started);
+    free(threads);
+    free(tasks);
+
+    return failures == 0 ? 0 : 1;
+}
+
+// --- Function to parse command-line arguments ---
+bool parse_command_line(int argc, char *argv[], JobControlParams *params) {
+    const char *printer_list = NULL;
+    const char *addresses[MAX_PRINTERS];
+    int num_addresses = 0;
+    int opt;
+    opterr = 0;
+
+    while ((opt = getopt(argc, argv, "h:H:p:o:A:s:nU:P:a")) != -1) {
+        switch (opt) {
+            case 'h':
+                if (num_addresses >= MAX_PRINTERS) {
+                    fprintf(stderr, "Error: At most %d printers can be given.\n", MAX_PRINTERS);
+                    return false;
+                }
+                addresses[num_addresses++] = optarg;
+                break;
+            case 'H':
+                printer_list = optarg;
+                break;
+            case 'p':
+                params->port = atoi(optarg);
+                break;
+            case 'o':
+                params->owner = optarg;
+                break;
+            case 'A':
+                params->min_age = atoi(optarg);
+                break;
+            case 's':
+                if (!parse_states(optarg, &params->states)) {
+                    return false;
+                }
+                break;
+            case 'n':
+                params->dry_run = true;
+                break;
+            case 'U':
+                params->username = optarg;
+                break;
+            case 'P':
+                params->password = optarg;
+                break;
+            case 'a':
+                params->use_auth = true;
+                break;
+
+            case '?':
+                if (strchr("hHpoAsUP", optopt))
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+                else if (isprint(optopt))
+                    fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+                else
+                    fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    // Ports given with -h/-H default to -p, wherever -p appears
+    for (int i = 0; i < num_addresses; i++) {
+        if (!add_printer(params, addresses[i])) {
+            return false;
+        }
+    }
+    if (printer_list && !load_printer_list(params, printer_list)) {
+        return false;
+    }
+
+    bool have_action = false;
+    if (optind + 1 == argc) {
+        for (size_t i = 0; i < sizeof(action_info) / sizeof(action_info[0]); i++) {
+            if (!strcmp(argv[optind], action_info[i].name)) {
+                params->action = (JobAction)i;
+                have_action = true;
+            }
+        }
+    }
+
+    if (params->num_printers == 0 || !have_action) {
+        fprintf(stderr, "Usage: %s (-h <hostname>[:<port>] ... | -H <file>) [-p <port>] [-o <owner>] [-A <seconds>] [-s <states>] [-n] [-U <username> -P <password> -a] cancel|purge|hold|release\n", argv[0]);
+        fprintf(stderr, "  -h <hostname>:  Printer to act on; repeat for more printers.\n");
+        fprintf(stderr, "  -H <file>:      File listing printers, one hostname[:port] per line.\n");
+        fprintf(stderr, "  -p <port>:      Port number for printers given without one (optional, default is 631).\n");
+        fprintf(stderr, "  -o <owner>:     Select jobs submitted by this user (cancel only).\n");
+        fprintf(stderr, "  -A <seconds>:   Select jobs created at least this many seconds ago (cancel only).\n");
+        fprintf(stderr, "  -s <states>:    Select jobs in these states: pending, held, processing, stopped (cancel only, comma separated).\n");
+        fprintf(stderr, "  -n:             Show what each printer would do without acting on it.\n");
+        fprintf(stderr, "  -U <username>:  Username for authentication (optional).\n");
+        fprintf(stderr, "  -P <password>:  Password for authentication (optional).\n");
+        fprintf(stderr, "  -a:             Enable authentication (use with -U and -P).\n");
+        fprintf(stderr, "  cancel:         Cancel the selected jobs (Cancel-Jobs, or Cancel-My-Jobs for your own).\n");
+        fprintf(stderr, "  purge:          Cancel every job on the printer (Cancel-Jobs).\n");
+        fprintf(stderr, "  hold:           Hold new jobs as they arrive (Hold-New-Jobs).\n");
+        fprintf(stderr, "  release:        Release jobs held by hold (Release-Held-New-Jobs).\n");
+        fprintf(stderr, "Where a printer lacks Cancel-Jobs, cancel and purge send one Cancel-Job per job; hold and release report it unsupported.\n");
+        return false;
+    }
+
+    if (params->action == ACTION_CANCEL && !params->owner && params->min_age <= 0 && !params->states) {
+        fprintf(stderr, "Error: cancel needs a selection (-o, -A or -s); use purge to cancel every job.\n");
+        return false;
+    }
+    if (params->action != ACTION_CANCEL && (params->owner || params->min_age > 0 || params->states)) {
+        fprintf(stderr, "Error: %s acts on the whole printer; -o, -A and -s only apply to cancel.\n",
+                action_info[params->action].name);
+        return false;
+    }
+
+    if (params->use_auth && (!params->username || !params->password)) {
+        fprintf(stderr, "Error: Authentication enabled (-a) but username (-U) and/or password (-P) are missing.\n");
+        return false;
+    }
+
+    return true;
+}
+
+// --- Function to add a hostname[:port] to the printer list ---
+bool add_printer(JobControlParams *params, const char *address) {
+    if (params->num_printers >= MAX_PRINTERS) {
+        fprintf(stderr, "Error: At most %d printers can be given.\n", MAX_PRINTERS);
+        return false;
+    }
+
+    PrinterAddress *printer = &params->printers[params->num_printers];
+    snprintf(printer->hostname, sizeof(printer->hostname), "%s", address);
+    printer->port = params->port;
+
+    // A single colon separates the port; more than one is an IPv6 address
+    char *colon = strrchr(printer->hostname, ':');
+    if (colon && colon == strchr(printer->hostname, ':')) {
+        *colon = '\0';
+        printer->port = atoi(colon + 1);
+    }
+
+    if (!printer->hostname[0] || printer->port <= 0) {
+        fprintf(stderr, "Error: Bad printer address \"%s\".\n", address);
+        return false;
+    }
+
+    params->num_printers++;
+    return true;
+}
+
+// --- Function to read printers from a file, ignoring blank lines and # comments ---
+bool load_printer_list(JobControlParams *params, const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Unable to open %s.\n", filename);
+        return false;
+    }
+
+    char line[HOSTNAME_MAX];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        char *start = line;
+        while (isspace((unsigned char)*start)) start++;
+        char *end = start + strcspn(start, "# \t\r\n");
+        *end = '\0';
+
+        if (*start) {
+            ok = add_printer(params, start);
+        }
+    }
+
+    fclose(fp);
+    return ok;
+}
+
+// --- Function to turn "pending,held" into a STATE_BIT mask ---
+bool parse_states(const char *list, unsigned *states) {
+    static const struct {
+        const char  *name;
+        ipp_jstate_t state;
+    } names[] = {
+        {"pending", IPP_JSTATE_PENDING},
+        {"held", IPP_JSTATE_HELD},
+        {"processing", IPP_JSTATE_PROCESSING},
+        {"stopped", IPP_JSTATE_STOPPED}
+    };
+
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        bool found = false;
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (strlen(names[i].name) == length && !strncmp(list, names[i].name, length)) {
+                *states |= STATE_BIT(names[i].state);
+                found = true;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Error: Unknown job state \"%.*s\".\n", (int)length, list);
+            return false;
+        }
+
+        list += length;
+        if (*list == ',') list++;
+    }
+
+    return true;
+}
+
+// --- Function to establish IPP connection (from print-mon.c) ---
+http_t *establish_ipp_connection(const char *hostname, int port) {
+    http_t *http = httpConnect(hostname, port, NULL, AF_UNSPEC, HTTP_ENCRYPTION_ALWAYS, 1, 30000, NULL);
+    if (!http) {
+        fprintf(stderr, "Error: Unable to connect to printer at %s:%d: %s\n", hostname, port, cupsGetErrorString());
+    }
+    return http;
+}
+
+// --- Function to handle authentication (from print-mon.c) ---
+bool handle_authentication(http_t *http, const char *username, const char *password) {
+    char credentials[CREDENTIALS_MAX];
+    snprintf(credentials, sizeof(credentials), "%s:%s", username, password);
+    char *auth_string = base64Encoder(credentials, strlen(credentials));
+    if (!auth_string) {
+        fprintf(stderr, "Error: base64 encoding failure!\n");
+        return false;
+    }
+    httpSetAuthString(http, "Basic", auth_string);
+    free(auth_string);
+    return true;
+}
+
+// --- Function to tell whether the selected owner is the requesting user ---
+bool owner_is_me(const JobControlParams *params) {
+    const char *user = params->use_auth ? params->username : cupsGetUser();
+    return params->owner && user && !strcmp(params->owner, user);
+}
+
+// --- Function to pick the batch operation the action sends, and its name ---
+ipp_op_t batch_operation(const JobControlParams *params, const char **name) {
+    // Our own jobs don't need operator rights
+    if (params->action == ACTION_CANCEL && owner_is_me(params)) {
+        *name = "Cancel-My-Jobs";
+        return IPP_OP_CANCEL_MY_JOBS;
+    }
+    *name = action_info[params->action].batch_name;
+    return action_info[params->action].batch_op;
+}
+
+// --- Function to fill task->job_ids with the jobs matching the selection, via one Get-Jobs ---
+bool list_jobs(http_t *http, PrinterTask *task, unsigned job_states) {
+    const JobControlParams *params = task->params;
+    ipp_t *request = ippNewRequest(IPP_OP_GET_JOBS);
+    if (!request) return false;
+
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, task->printer_uri);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL,
+                 params->use_auth ? params->username : cupsGetUser());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "which-jobs", NULL, "not-completed");
+    if (owner_is_me(params)) {
+        ippAddBoolean(request, IPP_TAG_OPERATION, "my-jobs", 1);
+    }
+
+    // job-printer-up-time is on the same clock as time-at-creation, so ages don't depend on our clock
+    const char *requested_attrs[] = {"job-id", "job-state", "job-originating-user-name", "time-at-creation", "job-printer-up-time"};
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD),
+                  "requested-attributes", 5, NULL, requested_attrs);
+
+    ipp_t *response = cupsDoRequest(http, request, "/ipp/print");
+    ippDelete(request);
+    task->round_trips++;
+    if (!response || ippGetStatusCode(response) > IPP_STATUS_OK_CONFLICTING) {
+        snprintf(task->error, sizeof(task->error), "Get-Jobs failed: %s", cupsGetErrorString());
+        ippDelete(response);
+        return false;
+    }
+
+    if (params->states) {
+        job_states &= params->states;
+    }
+
+    task->num_jobs = 0;
+    for (ipp_attribute_t *attr = ippGetFirstAttribute(response); attr; attr = ippGetNextAttribute(response)) {
+        while (attr && ippGetGroupTag(attr) != IPP_TAG_JOB) {
+            attr = ippGetNextAttribute(response);
+        }
+        if (!attr) break;
+
+        int job_id = 0, job_state = 0, created = -1, up_time = -1;
+        const char *owner = NULL;
+        for (; attr && ippGetGroupTag(attr) == IPP_TAG_JOB; attr = ippGetNextAttribute(response)) {
+            const char *name = ippGetName(attr);
+            if (!name) {
+                continue;
+            } else if (!strcmp(name, "job-id")) {
+                job_id = ippGetInteger(attr, 0);
+            } else if (!strcmp(name, "job-state")) {
+                job_state = ippGetInteger(attr, 0);
+            } else if (!strcmp(name, "job-originating-user-name")) {
+                owner = ippGetString(attr, 0, NULL);
+            } else if (!strcmp(name, "time-at-creation")) {
+                created = ippGetInteger(attr, 0);
+            } else if (!strcmp(name, "job-printer-up-time")) {
+                up_time = ippGetInteger(attr, 0);
+            }
+        }
+
+        bool selected = job_id > 0 && job_state >= IPP_JSTATE_PENDING && job_state <= IPP_JSTATE_STOPPED &&
+                        (job_states & STATE_BIT(job_state));
+        if (selected && params->owner) {
+            selected = owner && !strcmp(owner, params->owner);
+        }
+        if (selected && params->min_age > 0) {
+            selected = created >= 0 && up_time >= created && up_time - created >= params->min_age;
+        }
+
+        if (selected) {
+            if (task->num_jobs == JOB_IDS_MAX) {
+                fprintf(stderr, "%s:%d: more than %d jobs selected, acting on the first %d\n",
+                        task->printer->hostname, task->printer->port, JOB_IDS_MAX, JOB_IDS_MAX);
+                break;
+            }
+            task->job_ids[task->num_jobs++] = job_id;
+        }
+        if (!attr) break;
+    }
+
+    ippDelete(response);
+    return true;
+}
+
+// --- Function to send the action's batch operation, returns its status ---
+ipp_status_t do_batch_operation(http_t *http, PrinterTask *task) {
+    const JobControlParams *params = task->params;
+    ipp_op_t op = batch_operation(params, &task->method);
+
+    ipp_t *request = ippNewRequest(op);
+    if (!request) return IPP_STATUS_ERROR_INTERNAL;
+
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, task->printer_uri);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL,
+                 params->use_auth ? params->username : cupsGetUser());
+    if (!task->all_jobs) {
+        ippAddIntegers(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-ids", (size_t)task->num_jobs, task->job_ids);
+    }
+
+    ipp_t *response = cupsDoRequest(http, request, "/ipp/print");
+    ippDelete(request);
+    task->round_trips++;
+
+    ipp_status_t status = response ? ippGetStatusCode(response) : cupsGetError();
+    ippDelete(response);
+
+    if (status <= IPP_STATUS_OK_CONFLICTING && !task->all_jobs) {
+        task->succeeded = task->num_jobs;
+    }
+    return status;
+}
+
+// --- Printer thread: select jobs and act on them, batch first ---
+void *printer_worker(void *arg) {
+    PrinterTask *task = (PrinterTask *)arg;
+    const JobControlParams *params = task->params;
+    const ActionInfo *info = &action_info[params->action];
+
+    http_t *http = establish_ipp_connection(task->printer->hostname, task->printer->port);
+    if (!http) {
+        snprintf(task->error, sizeof(task->error), "unable to connect");
+        return NULL;
+    }
+    if (params->use_auth && !handle_authentication(http, params->username, params->password)) {
+        snprintf(task->error, sizeof(task->error), "authentication failed");
+        httpClose(http);
+        return NULL;
+    }
+
+    // Printer-wide operations and cancelling all of our own jobs take a single request;
+    // any other selection needs the job list first. For -n, the list shows what a
+    // Cancel-Jobs without job-ids would cancel; hold and release have no jobs to show.
+    bool whole_printer = params->action != ACTION_CANCEL ||
+                         (owner_is_me(params) && params->min_age <= 0 && !params->states);
+    if (!info->job_name) {
+        task->all_jobs = true;
+    } else if (params->dry_run || !whole_printer) {
+        if (!list_jobs(http, task, info->job_states)) {
+            httpClose(http);
+            return NULL;
+        }
+        if (!params->dry_run && task->num_jobs == 0) {
+            httpClose(http);
+            return NULL;
+        }
+    } else {
+        task->all_jobs = true;
+    }
+    if (params->dry_run) {
+        batch_operation(params, &task->method);
+        httpClose(http);
+        return NULL;
+    }
+
+    ipp_status_t status = do_batch_operation(http, task);
+    if (status == IPP_STATUS_ERROR_OPERATION_NOT_SUPPORTED && !info->job_name) {
+        // Holding existing jobs instead would change what the command means
+        snprintf(task->error, sizeof(task->error), "%s not supported by this printer", task->method);
+    } else if (status == IPP_STATUS_ERROR_OPERATION_NOT_SUPPORTED) {
+        // Fall back to one request per job, spread over several connections
+        if (task->all_jobs) {
+            task->all_jobs = false;
+            if (!list_jobs(http, task, info->job_states)) {
+                httpClose(http);
+                return NULL;
+            }
+        }
+        httpClose(http);
+
+        task->method = info->job_name;
+        if (task->num_jobs > 0) {
+            run_per_job(task, info->job_op);
+        } else {
+            task->method = NULL;
+        }
+        return NULL;
+    }
+
+    if (status > IPP_STATUS_OK_CONFLICTING) {
+        snprintf(task->error, sizeof(task->error), "%s failed: %s", task->method, ippErrorString(status));
+    }
+
+    httpClose(http);
+    return NULL;
+}
+
+// --- Function to run the per-job operation on task->job_ids over parallel connections ---
+void run_per_job(PrinterTask *task, ipp_op_t op) {
+    JobFanout fanout;
+    memset(&fanout, 0, sizeof(fanout));
+    fanout.task = task;
+    fanout.op = op;
+    pthread_mutex_init(&fanout.lock, NULL);
+
+    pthread_t workers[FALLBACK_WORKERS];
+    int num_workers = 0;
+    for (; num_workers < FALLBACK_WORKERS && num_workers < task->num_jobs; num_workers++) {
+        if (pthread_create(&workers[num_workers], NULL, job_worker, &fanout) != 0) {
+            break;
+        }
+    }
+
+    // If no thread would start, do the work here
+    if (num_workers == 0) {
+        job_worker(&fanout);
+    }
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&fanout.lock);
+}
+
+// --- Per-job worker: takes job IDs off the shared list until it is empty ---
+void *job_worker(void *arg) {
+    JobFanout *fanout = (JobFanout *)arg;
+    PrinterTask *task = fanout->task;
+    const JobControlParams *params = task->params;
+    int succeeded = 0, failed = 0, round_trips = 0;
+
+    http_t *http = establish_ipp_connection(task->printer->hostname, task->printer->port);
+    if (http && params->use_auth && !handle_authentication(http, params->username, params->password)) {
+        httpClose(http);
+        http = NULL;
+    }
+
+    while (true) {
+        pthread_mutex_lock(&fanout->lock);
+        int index = fanout->next < task->num_jobs ? fanout->next++ : -1;
+        pthread_mutex_unlock(&fanout->lock);
+        if (index < 0) {
+            break;
+        }
+
+        // Without a connection, the jobs this worker takes count as failed
+        if (!http) {
+            failed++;
+            continue;
+        }
+
+        ipp_t *request = ippNewRequest(fanout->op);
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, task->printer_uri);
+        ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", task->job_ids[index]);
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL,
+                     params->use_auth ? params->username : cupsGetUser());
+
+        ipp_t *response = cupsDoRequest(http, request, "/ipp/print");
+        ippDelete(request);
+        round_trips++;
+
+        if (response && ippGetStatusCode(response) <= IPP_STATUS_OK_CONFLICTING) {
+            succeeded++;
+        } else {
+            fprintf(stderr, "%s:%d: job %d: %s\n", task->printer->hostname, task->printer->port,
+                    task->job_ids[index], cupsGetErrorString());
+            failed++;
+        }
+        ippDelete(response);
+    }
+
+    if (http) {
+        httpClose(http);
+    }
+
+    pthread_mutex_lock(&fanout->lock);
+    task->succeeded += succeeded;
+    task->failed += failed;
+    task->round_trips += round_trips;
+    pthread_mutex_unlock(&fanout->lock);
+
+    return NULL;
+}
+
+// --- Base64 encoding function (from printLabel.c) ---
+char *base64Encoder(const char *data, size_t input_length) {
+    const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t output_length = (size_t)(4.0 * ceil((double)input_length / 3.0));
+    char *encoded_data = malloc(output_length + 1);
+    if (!encoded_data) return NULL;
+
+    size_t i, j;
+    for (i = 0, j = 0; i < input_length;) {
+        uint32_t octet_a = i < input_length ? (unsigned char)data[i++] : 0;
+        uint32_t octet_b = i < input_length ? (unsigned char)data[i++] : 0;
+        uint32_t octet_c = i < input_length ? (unsigned char)data[i++] : 0;
+
+        uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
+
+        encoded_data[j++] = base64_chars[(triple >> 3 * 6) & 0x3F];
+        encoded_data[j++] = base64_chars[(triple >> 2 * 6) & 0x3F];
+        encoded_data[j++] = base64_chars[(triple >> 1 * 6) & 0x3F];
+        encoded_data[j++] = base64_chars[(triple >> 0 * 6) & 0x3F];
+    }
+
+    for (int i = 0; i < (int)(3 - input_length % 3) % 3; i++) {
+        encoded_data[output_length - 1 - i] = '=';
+    }
+
+    encoded_data[output_length] = '\0';
+    return encoded_data;
+}
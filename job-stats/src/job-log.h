@@ -0,0 +1,65 @@
+#ifndef JOB_LOG_H
+#define JOB_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Same module in print-mon and job-stats; keep the copies in sync
+
+#define JOB_LOG_MAGIC "CDJOBLOG"
+#define JOB_LOG_VERSION 1
+#define JOB_LOG_PRINTER_MAX 34      // hostname:port, truncated to keep records at 64 bytes
+
+// --- Record types ---
+enum {
+    JOB_EVENT_SUBMITTED = 1,        // Print-Job accepted; time_us is when sending started
+    JOB_EVENT_REJECTED,             // Print-Job refused; status holds the IPP status code
+    JOB_EVENT_STATE                 // job-state or job-state-reasons changed
+};
+
+// --- job-state-reasons kept as bits; anything else sets JOB_REASON_OTHER ---
+#define JOB_REASON_OTHER 0x8000
+extern const char * const job_log_reasons[15];
+
+// --- First 64 bytes of the file ---
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    char     reserved[48];
+} JobLogHeader;
+
+// --- One lifecycle event, fixed size so the file can be mapped and scanned as an array ---
+// Every record repeats submitted_us, so latency needs no join with the job's first record.
+typedef struct {
+    int64_t  time_us;               // Microseconds since the epoch
+    int64_t  submitted_us;          // When the job was submitted
+    uint32_t printer_hash;          // FNV-1a of the full hostname:port, for grouping
+    int32_t  job_id;                // 0 for a rejected submission
+    uint8_t  event;
+    uint8_t  job_state;             // ipp_jstate_t, 0 if unknown
+    uint16_t reasons;               // job_log_reasons bits
+    uint16_t status;                // IPP status code of the Print-Job response
+    char     printer[JOB_LOG_PRINTER_MAX];  // hostname:port, nul-terminated unless truncated
+} JobLogRecord;
+
+// Opens (creating if needed) a log for appending; -1 on failure with errno set
+int job_log_open(const char *path);
+
+// Appends one record with a single write, so concurrent writers don't interleave
+bool job_log_append(int fd, const JobLogRecord *record);
+
+// Sets up record's printer name and hash from hostname and port
+void job_log_set_printer(JobLogRecord *record, const char *hostname, int port);
+
+// Maps a job-state-reasons keyword to its bit
+uint16_t job_log_reason_bit(const char *reason);
+
+// Returns the default log path, $XDG_STATE_HOME/cups-demo/job-timeline.log, creating the directory
+bool job_log_default_path(char *path, size_t pathsize);
+
+// Returns the current time in microseconds since the epoch
+int64_t job_log_now(void);
+
+#endif
@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "job-log.h"
+
+// --- Constants ---
+#define LOG_PATH_MAX 1024
+#define PRINTER_SLOTS 8192          // Power of two, well above the printers one log sees
+#define STATUS_SLOTS 8              // Distinct rejection statuses kept per printer
+#define US_PER_HOUR 3600000000LL
+#define JSTATE_CANCELED 7           // ipp_jstate_t values; job-stats doesn't link libcups
+#define JSTATE_ABORTED 8
+#define JSTATE_COMPLETED 9
+
+// --- Structures ---
+typedef struct {
+    uint32_t    hash;
+    bool        used;
+    char        name[JOB_LOG_PRINTER_MAX + 1];
+    long        completed;
+    long        canceled;
+    long        aborted;
+    long        rejected;
+    long        reason_counts[16];  // Over canceled and aborted jobs, by job_log_reasons bit
+    uint16_t    statuses[STATUS_SLOTS];
+    long        status_counts[STATUS_SLOTS];
+} PrinterStats;
+
+// One completed job, reduced to what the percentiles need
+typedef struct {
+    uint32_t    printer;            // Slot in the printer table, then rank by name for sorting
+    int32_t     hour;               // Hours since the epoch, from the completion time
+    int64_t     latency_us;         // Submit to completed
+} Sample;
+
+typedef struct {
+    const char *printer;            // -p, hostname:port as logged
+    int64_t     since_us;
+    int64_t     until_us;
+    bool        totals_only;
+} StatsParams;
+
+// --- Function Prototypes ---
+bool parse_command_line(int argc, char *argv[], StatsParams *params, char *default_log, size_t default_size);
+bool parse_time(const char *text, int64_t *time_us);
+bool scan_log(const char *path, const StatsParams *params, uint32_t printer_hash);
+PrinterStats *find_printer(const JobLogRecord *record);
+bool add_sample(uint32_t printer, int32_t hour, int64_t latency_us);
+int sort_printers(int *order);
+int compare_samples(const void *a, const void *b);
+int compare_hours(const void *a, const void *b);
+int compare_latency(const void *a, const void *b);
+void print_percentiles(const char *printer, const char *hour, int64_t *latencies, size_t count);
+void print_latency_rows(const char *printer, const Sample *group, size_t count, int64_t *latencies, bool totals_only);
+void print_latency_report(const StatsParams *params);
+void print_outcome_report(void);
+
+static PrinterStats printers[PRINTER_SLOTS];
+static int num_printers;
+static Sample *samples;
+static size_t num_samples, samples_size;
+
+int main(int argc, char *argv[]) {
+    StatsParams params;
+    char default_log[LOG_PATH_MAX];
+    memset(&params, 0, sizeof(params));
+    params.until_us = INT64_MAX;
+
+    // --- Parse command-line arguments ---
+    if (!parse_command_line(argc, argv, &params, default_log, sizeof(default_log))) {
+        return 1;
+    }
+
+    // Filtering on the hash keeps the scan free of string compares
+    uint32_t printer_hash = 0;
+    if (params.printer) {
+        JobLogRecord probe;
+        const char *colon = strrchr(params.printer, ':');
+        char hostname[LOG_PATH_MAX];
+        if (!colon || colon == params.printer) {
+            fprintf(stderr, "Error: -p takes hostname:port, as print-mon logs it.\n");
+            return 1;
+        }
+        snprintf(hostname, sizeof(hostname), "%.*s", (int)(colon - params.printer), params.printer);
+        job_log_set_printer(&probe, hostname, atoi(colon + 1));
+        printer_hash = probe.printer_hash;
+    }
+
+    // --- Scan each log ---
+    bool ok = true;
+    if (optind == argc) {
+        ok = scan_log(default_log, &params, printer_hash);
+    }
+    for (int i = optind; i < argc; i++) {
+        ok = scan_log(argv[i], &params, printer_hash) && ok;
+    }
+
+    // --- Report ---
+    print_latency_report(&params);
+    print_outcome_report();
+
+    free(samples);
+    return ok ? 0 : 1;
+}
+
+// --- Function to parse command-line arguments ---
+bool parse_command_line(int argc, char *argv[], StatsParams *params, char *default_log, size_t default_size) {
+    int opt;
+    opterr = 0;
+
+    while ((opt = getopt(argc, argv, "p:s:u:T")) != -1) {
+        switch (opt) {
+            case 'p':
+                params->printer = optarg;
+                break;
+            case 's':
+                if (!parse_time(optarg, &params->since_us)) {
+                    return false;
+                }
+                break;
+            case 'u':
+                if (!parse_time(optarg, &params->until_us)) {
+                    return false;
+                }
+                break;
+            case 'T':
+                params->totals_only = true;
+                break;
+
+            case '?':
+                if (strchr("psu", optopt))
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+                else if (isprint(optopt))
+                    fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+                else
+                    fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    if (optind == argc && !job_log_default_path(default_log, default_size)) {
+        fprintf(stderr, "Usage: %s [-p <hostname:port>] [-s <time>] [-u <time>] [-T] [<logfile> ...]\n", argv[0]);
+        fprintf(stderr, "  -p <printer>:   Only this printer, as hostname:port (optional).\n");
+        fprintf(stderr, "  -s <time>:      Only jobs finished at or after \"YYYY-MM-DD[ HH:MM]\", local time (optional).\n");
+        fprintf(stderr, "  -u <time>:      Only jobs finished before \"YYYY-MM-DD[ HH:MM]\", local time (optional).\n");
+        fprintf(stderr, "  -T:             Totals only, no hourly rows (optional).\n");
+        fprintf(stderr, "  <logfile>:      print-mon job timeline logs (default is $XDG_STATE_HOME/cups-demo/job-timeline.log).\n");
+        return false;
+    }
+
+    return true;
+}
+
+// --- Function to parse "YYYY-MM-DD" or "YYYY-MM-DD HH:MM" in local time ---
+bool parse_time(const char *text, int64_t *time_us) {
+    struct tm tm;
+    int consumed = 0;
+    memset(&tm, 0, sizeof(tm));
+
+    int fields = sscanf(text, "%d-%d-%d%n %d:%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &consumed,
+                        &tm.tm_hour, &tm.tm_min, &consumed);
+    if ((fields != 3 && fields != 5) || text[consumed] || tm.tm_mon < 1 || tm.tm_mon > 12 || tm.tm_mday < 1 ||
+        tm.tm_mday > 31 || tm.tm_hour < 0 || tm.tm_hour > 23 || tm.tm_min < 0 || tm.tm_min > 59) {
+        fprintf(stderr, "Error: Bad time \"%s\", expected YYYY-MM-DD or \"YYYY-MM-DD HH:MM\".\n", text);
+        return false;
+    }
+
+    tm.tm_year -= 1900;
+    tm.tm_mon--;
+    tm.tm_isdst = -1;
+    *time_us = (int64_t)mktime(&tm) * 1000000;
+    return true;
+}
+
+// --- Function to map a log and fold its records into the statistics ---
+bool scan_log(const char *path, const StatsParams *params, uint32_t printer_hash) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Unable to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) || (size_t)info.st_size < sizeof(JobLogHeader)) {
+        fprintf(stderr, "Error: %s isn't a job timeline log.\n", path);
+        close(fd);
+        return false;
+    }
+
+    const unsigned char *map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Unable to map %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    madvise((void *)map, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    const JobLogHeader *header = (const JobLogHeader *)map;
+    if (memcmp(header->magic, JOB_LOG_MAGIC, sizeof(header->magic)) || header->version != JOB_LOG_VERSION ||
+        header->record_size != sizeof(JobLogRecord)) {
+        fprintf(stderr, "Error: %s isn't a version %d job timeline log.\n", path, JOB_LOG_VERSION);
+        munmap((void *)map, (size_t)info.st_size);
+        return false;
+    }
+
+    // A record cut short by a crash at the end is ignored
+    const JobLogRecord *records = (const JobLogRecord *)(map + sizeof(JobLogHeader));
+    size_t count = ((size_t)info.st_size - sizeof(JobLogHeader)) / sizeof(JobLogRecord);
+    bool ok = true;
+
+    // One pass over fixed-size records; most are transitions that only need the two compares
+    for (size_t i = 0; i < count && ok; i++) {
+        const JobLogRecord *record = &records[i];
+        bool finished = record->event == JOB_EVENT_STATE && record->job_state >= JSTATE_CANCELED;
+        if (!finished && record->event != JOB_EVENT_REJECTED) {
+            continue;
+        }
+        if (record->time_us < params->since_us || record->time_us >= params->until_us ||
+            (params->printer && record->printer_hash != printer_hash)) {
+            continue;
+        }
+
+        PrinterStats *printer = find_printer(record);
+        if (!printer) {
+            fprintf(stderr, "Error: More than %d printers in the logs.\n", PRINTER_SLOTS / 2);
+            ok = false;
+        } else if (record->event == JOB_EVENT_REJECTED) {
+            printer->rejected++;
+            for (int s = 0; s < STATUS_SLOTS; s++) {
+                if (printer->status_counts[s] == 0 || printer->statuses[s] == record->status) {
+                    printer->statuses[s] = record->status;
+                    printer->status_counts[s]++;
+                    break;
+                }
+            }
+        } else if (record->job_state == JSTATE_COMPLETED) {
+            printer->completed++;
+            ok = add_sample((uint32_t)(printer - printers), (int32_t)(record->time_us / US_PER_HOUR),
+                            record->time_us - record->submitted_us);
+        } else {
+            if (record->job_state == JSTATE_CANCELED) {
+                printer->canceled++;
+            } else {
+                printer->aborted++;
+            }
+            for (int bit = 0; bit < 16; bit++) {
+                printer->reason_counts[bit] += (record->reasons >> bit) & 1;
+            }
+        }
+    }
+
+    munmap((void *)map, (size_t)info.st_size);
+    return ok;
+}
+
+// --- Function to find or add a printer's slot, NULL when the table is too full ---
+PrinterStats *find_printer(const JobLogRecord *record) {
+    uint32_t slot = record->printer_hash & (PRINTER_SLOTS - 1);
+
+    while (printers[slot].used) {
+        if (printers[slot].hash == record->printer_hash) {
+            return &printers[slot];
+        }
+        slot = (slot + 1) & (PRINTER_SLOTS - 1);
+    }
+
+    // Keep probe chains short by never filling more than half the table
+    if (num_printers >= PRINTER_SLOTS / 2) {
+        return NULL;
+    }
+    num_printers++;
+    printers[slot].used = true;
+    printers[slot].hash = record->printer_hash;
+    memcpy(printers[slot].name, record->printer, sizeof(record->printer));
+    printers[slot].name[sizeof(record->printer)] = '\0';
+    return &printers[slot];
+}
+
+// --- Function to record one completed job's latency ---
+bool add_sample(uint32_t printer, int32_t hour, int64_t latency_us) {
+    if (num_samples == samples_size) {
+        size_t size = samples_size ? samples_size * 2 : 65536;
+        Sample *grown = realloc(samples, size * sizeof(Sample));
+        if (!grown) {
+            fprintf(stderr, "Error: Out of memory.\n");
+            return false;
+        }
+        samples = grown;
+        samples_size = size;
+    }
+
+    samples[num_samples].printer = printer;
+    samples[num_samples].hour = hour;
+    samples[num_samples].latency_us = latency_us;
+    num_samples++;
+    return true;
+}
+
+// --- Function to list the used printer slots in name order, returns how many ---
+int sort_printers(int *order) {
+    int count = 0;
+    for (int slot = 0; slot < PRINTER_SLOTS; slot++) {
+        if (printers[slot].used) {
+            int i = count++;
+            while (i > 0 && strcmp(printers[order[i - 1]].name, printers[slot].name) > 0) {
+                order[i] = order[i - 1];
+                i--;
+            }
+            order[i] = slot;
+        }
+    }
+    return count;
+}
+
+// --- Function to order samples by printer rank, hour, then latency ---
+int compare_samples(const void *a, const void *b) {
+    const Sample *x = (const Sample *)a, *y = (const Sample *)b;
+    if (x->printer != y->printer) {
+        return x->printer < y->printer ? -1 : 1;
+    }
+    if (x->hour != y->hour) {
+        return x->hour < y->hour ? -1 : 1;
+    }
+    return x->latency_us < y->latency_us ? -1 : x->latency_us > y->latency_us;
+}
+
+// --- Function to order samples by hour, then latency, across printers ---
+int compare_hours(const void *a, const void *b) {
+    const Sample *x = (const Sample *)a, *y = (const Sample *)b;
+    if (x->hour != y->hour) {
+        return x->hour < y->hour ? -1 : 1;
+    }
+    return x->latency_us < y->latency_us ? -1 : x->latency_us > y->latency_us;
+}
+
+// --- Function to order latencies ---
+int compare_latency(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// --- Function to print one row of nearest-rank percentiles; latencies must be sorted ---
+void print_percentiles(const char *printer, const char *hour, int64_t *latencies, size_t count) {
+    static const int percentiles[] = {50, 90, 99};
+    double values[3];
+
+    for (int i = 0; i < 3; i++) {
+        size_t rank = (count * (size_t)percentiles[i] + 99) / 100;
+        values[i] = latencies[rank > 0 ? rank - 1 : 0] / 1000.0;
+    }
+    printf("%-34s %-16s %8zu %10.0f %10.0f %10.0f %10.0f\n", printer, hour, count,
+           values[0], values[1], values[2], latencies[count - 1] / 1000.0);
+}
+
+// --- Function to print a group's hourly rows and its "all" row; group must be sorted by hour, then latency ---
+void print_latency_rows(const char *printer, const Sample *group, size_t count, int64_t *latencies, bool totals_only) {
+    for (size_t hour_start = 0; hour_start < count && !totals_only;) {
+        size_t hour_end = hour_start;
+        while (hour_end < count && group[hour_end].hour == group[hour_start].hour) {
+            latencies[hour_end - hour_start] = group[hour_end].latency_us;
+            hour_end++;
+        }
+        char hour[32];
+        time_t hour_time = (time_t)group[hour_start].hour * 3600;
+        strftime(hour, sizeof(hour), "%Y-%m-%d %H:00", localtime(&hour_time));
+        print_percentiles(printer, hour, latencies, hour_end - hour_start);
+        hour_start = hour_end;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        latencies[i] = group[i].latency_us;
+    }
+    qsort(latencies, count, sizeof(int64_t), compare_latency);
+    print_percentiles(printer, "all", latencies, count);
+}
+
+// --- Function to print latency percentiles per printer, per hour and overall ---
+void print_latency_report(const StatsParams *params) {
+    printf("Submit-to-completed latency (ms)\n");
+    printf("%-34s %-16s %8s %10s %10s %10s %10s\n", "printer", "hour", "jobs", "p50", "p90", "p99", "max");
+    if (num_samples == 0) {
+        printf("(no completed jobs)\n");
+        return;
+    }
+
+    // Sort on name rank rather than name, to keep string compares out of the sort
+    static int order[PRINTER_SLOTS], rank[PRINTER_SLOTS];
+    int count = sort_printers(order);
+    for (int i = 0; i < count; i++) {
+        rank[order[i]] = i;
+    }
+    for (size_t i = 0; i < num_samples; i++) {
+        samples[i].printer = (uint32_t)rank[samples[i].printer];
+    }
+
+    qsort(samples, num_samples, sizeof(Sample), compare_samples);
+    int64_t *latencies = malloc(num_samples * sizeof(int64_t));
+    if (!latencies) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return;
+    }
+
+    // Samples are grouped by printer, then by hour, each group already in latency order
+    for (size_t start = 0; start < num_samples;) {
+        size_t end = start;
+        while (end < num_samples && samples[end].printer == samples[start].printer) {
+            end++;
+        }
+        print_latency_rows(printers[order[samples[start].printer]].name, samples + start, end - start, latencies,
+                           params->totals_only);
+        start = end;
+    }
+
+    // The same figures across every printer; with one printer they would repeat its rows
+    if (count > 1) {
+        qsort(samples, num_samples, sizeof(Sample), compare_hours);
+        print_latency_rows("(all printers)", samples, num_samples, latencies, params->totals_only);
+    }
+
+    free(latencies);
+}
+
+// --- Function to print job outcomes and failure reasons per printer ---
+void print_outcome_report(void) {
+    static int order[PRINTER_SLOTS];
+    int count = sort_printers(order);
+
+    printf("\nJob outcomes\n");
+    printf("%-34s %10s %10s %10s %10s\n", "printer", "completed", "canceled", "aborted", "rejected");
+    if (count == 0) {
+        printf("(no finished jobs)\n");
+    }
+
+    for (int i = 0; i < count; i++) {
+        const PrinterStats *printer = &printers[order[i]];
+        printf("%-34s %10ld %10ld %10ld %10ld\n", printer->name, printer->completed, printer->canceled,
+               printer->aborted, printer->rejected);
+
+        for (int bit = 0; bit < 16; bit++) {
+            if (printer->reason_counts[bit] > 0) {
+                printf("  %-32s %10ld\n", bit < 15 ? job_log_reasons[bit] : "other reasons", printer->reason_counts[bit]);
+            }
+        }
+        for (int s = 0; s < STATUS_SLOTS && printer->status_counts[s] > 0; s++) {
+            printf("  rejected with status 0x%04x      %10ld\n", printer->statuses[s], printer->status_counts[s]);
+        }
+    }
+}
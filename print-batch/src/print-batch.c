@@ -0,0 +1,770 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <libcups3/cups/cups.h>
+#include "preflight.h"
+
+// --- Constants ---
+#define PRINTER_URI_MAX 256
+#define CREDENTIALS_MAX 256
+#define JOB_NAME_MAX 64
+#define DEFAULT_PORT 631
+#define DEFAULT_X_DIMENSION 10160
+#define DEFAULT_Y_DIMENSION 2540
+#define DEFAULT_MEDIA_TRACKING "mark"
+#define DEFAULT_DARKNESS 100
+#define DEFAULT_SPEED 500
+#define DEFAULT_RESOLUTION 203
+#define MAX_WORKERS 64
+#define MAX_COLUMNS 64
+#define RENDER_AHEAD_PER_WORKER 4   // Rendered labels each worker may keep queued ahead of the submitter
+
+// --- Structures ---
+typedef struct {
+    const char *hostname;
+    int         port;
+    const char *template_file;
+    const char *data_file;
+    const char *filetype;
+    int         x_dimension;
+    int         y_dimension;
+    const char *media_tracking;
+    int         darkness;
+    int         speed;
+    int         resolution;
+    const char *username;
+    const char *password;
+    bool        use_auth;
+    bool        strict;         // Fail preflight instead of adjusting to the nearest supported value
+    int         workers;
+    char        delimiter;      // 0 = detect from the header line
+} BatchParams;
+
+// A template is a list of literal runs and {{column}} references
+typedef struct {
+    const char *text;           // Literal text, or NULL for a column reference
+    size_t      length;
+    int         column;
+} TemplateSegment;
+
+typedef struct {
+    char            *buffer;
+    size_t           num_segments;
+    TemplateSegment *segments;
+} LabelTemplate;
+
+// Records are parsed in place; fields[record * num_columns + column]
+typedef struct {
+    char   *buffer;
+    size_t  num_columns;
+    char   *columns[MAX_COLUMNS];
+    size_t  num_records;
+    char  **fields;
+} DataFile;
+
+typedef struct {
+    char   *data;
+    size_t  length;
+    bool    ready;
+} RenderedLabel;
+
+// Workers render records into a ring of slots; the submitter drains it in record order
+typedef struct {
+    const LabelTemplate *tmpl;
+    const DataFile      *data;
+    RenderedLabel       *slots;
+    size_t               window;
+    size_t               next_render;
+    size_t               next_submit;
+    bool                 abort;
+    pthread_mutex_t      lock;
+    pthread_cond_t       rendered;
+    pthread_cond_t       submitted;
+} RenderPipeline;
+
+// --- Function Prototypes ---
+char *base64Encoder(const char *data, size_t input_length);
+bool parse_command_line(int argc, char *argv[], BatchParams *params);
+http_t *establish_ipp_connection(const char *hostname, int port);
+bool handle_authentication(http_t *http, const char *username, const char *password);
+ipp_t *create_print_job_request(const BatchParams *params, const char *printer_uri_str, const char *job_name);
+char *read_file(const char *filename, size_t *length);
+bool load_data_file(const char *filename, char delimiter, DataFile *data);
+bool load_template(const char *filename, const DataFile *data, LabelTemplate *tmpl);
+char *render_label(const LabelTemplate *tmpl, const DataFile *data, size_t record, size_t *length);
+void *render_worker(void *arg);
+int submit_label(http_t *http, const BatchParams *params, const char *printer_uri_str, size_t record, const char *data, size_t length);
+
+int main(int argc, char *argv[]) {
+    BatchParams params;
+    memset(&params, 0, sizeof(params));
+
+    params.port = DEFAULT_PORT;
+    params.x_dimension = DEFAULT_X_DIMENSION;
+    params.y_dimension = DEFAULT_Y_DIMENSION;
+    params.media_tracking = DEFAULT_MEDIA_TRACKING;
+    params.darkness = DEFAULT_DARKNESS;
+    params.speed = DEFAULT_SPEED;
+    params.resolution = DEFAULT_RESOLUTION;
+    params.workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    // --- Parse command-line arguments ---
+    if (!parse_command_line(argc, argv, &params)) {
+        return 1;
+    }
+
+    // --- Load the data file and template ---
+    DataFile data;
+    LabelTemplate tmpl;
+    if (!load_data_file(params.data_file, params.delimiter, &data)) {
+        return 1;
+    }
+    if (!load_template(params.template_file, &data, &tmpl)) {
+        free(data.fields);
+        free(data.buffer);
+        return 1;
+    }
+    if (data.num_records == 0) {
+        fprintf(stderr, "Error: %s contains no records.\n", params.data_file);
+        free(tmpl.segments);
+        free(tmpl.buffer);
+        free(data.fields);
+        free(data.buffer);
+        return 1;
+    }
+
+    // --- Construct printer URI ---
+    char printer_uri_str[PRINTER_URI_MAX];
+    snprintf(printer_uri_str, sizeof(printer_uri_str), "ipp://%s:%d/ipp/print", params.hostname, params.port);
+
+    // --- Establish connection ---
+    http_t *http = establish_ipp_connection(params.hostname, params.port);
+    if (!http) {
+        fprintf(stderr, "Error: Unable to connect to printer at %s:%d.\n", params.hostname, params.port);
+        return 1;
+    }
+
+    // --- Handle Authentication ---
+    if (params.use_auth && !handle_authentication(http, params.username, params.password)) {
+        fprintf(stderr, "Error: Authentication failed.\n");
+        httpClose(http);
+        return 1;
+    }
+
+    // --- Preflight the job settings once, before rendering or sending anything ---
+    // caps stays alive for the run since media_tracking may point into it
+    ipp_t *caps = preflight_get_capabilities(http, printer_uri_str, params.hostname, params.port, PREFLIGHT_CACHE_MAX_AGE);
+    if (caps) {
+        PreflightJob job = {params.filetype, params.x_dimension, params.y_dimension, params.media_tracking,
+                            params.darkness, params.speed, params.resolution};
+        if (!preflight_check(caps, &job, params.strict)) {
+            fprintf(stderr, "Error: Job failed preflight, nothing was sent.\n");
+            ippDelete(caps);
+            httpClose(http);
+            return 1;
+        }
+        params.x_dimension = job.x_dimension;
+        params.y_dimension = job.y_dimension;
+        params.media_tracking = job.media_tracking;
+        params.darkness = job.darkness;
+        params.speed = job.speed;
+        params.resolution = job.resolution;
+    } else {
+        fprintf(stderr, "Warning: Printer capabilities unavailable, skipping preflight.\n");
+    }
+
+    // --- Start render workers ---
+    RenderPipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.tmpl = &tmpl;
+    pipeline.data = &data;
+    pipeline.window = (size_t)params.workers * RENDER_AHEAD_PER_WORKER;
+    pipeline.slots = calloc(pipeline.window, sizeof(RenderedLabel));
+    if (!pipeline.slots) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        ippDelete(caps);
+        httpClose(http);
+        return 1;
+    }
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.rendered, NULL);
+    pthread_cond_init(&pipeline.submitted, NULL);
+
+    pthread_t workers[MAX_WORKERS];
+    int num_workers = 0;
+    for (; num_workers < params.workers; num_workers++) {
+        if (pthread_create(&workers[num_workers], NULL, render_worker, &pipeline) != 0) {
+            fprintf(stderr, "Error: Unable to start render worker %d.\n", num_workers + 1);
+            break;
+        }
+    }
+
+    // --- Submit labels in record order as they finish rendering ---
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t submitted = 0, failed = 0;
+    for (size_t record = 0; num_workers > 0 && record < data.num_records; record++) {
+        RenderedLabel *slot = &pipeline.slots[record % pipeline.window];
+
+        pthread_mutex_lock(&pipeline.lock);
+        while (!slot->ready) {
+            pthread_cond_wait(&pipeline.rendered, &pipeline.lock);
+        }
+        pthread_mutex_unlock(&pipeline.lock);
+
+        if (!slot->data) {
+            fprintf(stderr, "Error: Unable to render record %zu.\n", record + 1);
+            failed++;
+        } else if (submit_label(http, &params, printer_uri_str, record, slot->data, slot->length) > 0) {
+            submitted++;
+        } else {
+            failed++;
+        }
+
+        pthread_mutex_lock(&pipeline.lock);
+        free(slot->data);
+        slot->data = NULL;
+        slot->ready = false;
+        pipeline.next_submit = record + 1;
+        pthread_cond_broadcast(&pipeline.submitted);
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+
+    // --- Stop workers ---
+    pthread_mutex_lock(&pipeline.lock);
+    pipeline.abort = true;
+    pthread_cond_broadcast(&pipeline.submitted);
+    pthread_mutex_unlock(&pipeline.lock);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    fprintf(stdout, "Submitted %zu of %zu labels (%zu failed) in %.2f seconds, %.1f labels/sec, %d render workers.\n",
+            submitted, data.num_records, failed, elapsed, elapsed > 0.0 ? (double)submitted / elapsed : 0.0, num_workers);
+
+    for (size_t i = 0; i < pipeline.window; i++) {
+        free(pipeline.slots[i].data);
+    }
+    free(pipeline.slots);
+    pthread_cond_destroy(&pipeline.submitted);
+    pthread_cond_destroy(&pipeline.rendered);
+    pthread_mutex_destroy(&pipeline.lock);
+    free(tmpl.segments);
+    free(tmpl.buffer);
+    free(data.fields);
+    free(data.buffer);
+    ippDelete(caps);
+    httpClose(http);
+
+    return (failed == 0 && num_workers > 0) ? 0 : 1;
+}
+
+// --- Function to parse command-line arguments ---
+bool parse_command_line(int argc, char *argv[], BatchParams *params) {
+    int opt;
+    opterr = 0;
+
+    while ((opt = getopt(argc, argv, "h:p:T:d:m:U:P:ax:y:t:j:D:S")) != -1) {
+        switch (opt) {
+            case 'h':
+                params->hostname = optarg;
+                break;
+            case 'p':
+                params->port = atoi(optarg);
+                break;
+            case 'T':
+                params->template_file = optarg;
+                break;
+            case 'd':
+                params->data_file = optarg;
+                break;
+            case 'm':
+                params->filetype = optarg;
+                break;
+            case 'U':
+                params->username = optarg;
+                break;
+            case 'P':
+                params->password = optarg;
+                break;
+            case 'a':
+                params->use_auth = true;
+                break;
+            case 'x':
+                params->x_dimension = atoi(optarg);
+                break;
+            case 'y':
+                params->y_dimension = atoi(optarg);
+                break;
+            case 't':
+                params->media_tracking = optarg;
+                break;
+            case 'j':
+                params->workers = atoi(optarg);
+                break;
+            case 'D':
+                params->delimiter = strcmp(optarg, "tab") == 0 ? '\t' : optarg[0];
+                break;
+            case 'S':
+                params->strict = true;
+                break;
+
+            case '?':
+                if (strchr("hpTdmUPxytjD", optopt))
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+                else if (isprint(optopt))
+                    fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+                else
+                    fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    if (!params->hostname || !params->template_file || !params->data_file || !params->filetype) {
+        fprintf(stderr, "Usage: %s -h <hostname> [-p <port>] -T <template> -d <datafile> -m <mime_type> [-j <workers>] [-D <delimiter>] [-x <xdim>] [-y <ydim>] [-t <tracking>] [-S] [-U <username> -P <password> -a]\n", argv[0]);
+        fprintf(stderr, "  -h <hostname>:  Hostname or IP address of the printer (required).\n");
+        fprintf(stderr, "  -p <port>:      Port number for the printer (optional, default is 631).\n");
+        fprintf(stderr, "  -T <template>:  Label template; {{column}} is replaced by that column of each record (required).\n");
+        fprintf(stderr, "  -d <datafile>:  CSV/TSV file whose first line names the columns (required).\n");
+        fprintf(stderr, "  -m <mime_type>: MIME type of the rendered labels (e.g., text/plain, application/vnd.zebra-zpl) (required).\n");
+        fprintf(stderr, "  -j <workers>:   Number of render threads (optional, default is the number of CPUs).\n");
+        fprintf(stderr, "  -D <delimiter>: Field delimiter, a character or \"tab\" (optional, detected from the header line).\n");
+        fprintf(stderr, "  -x <xdim>:      X dimension of the media in 1/1000 inch (optional, default is 10160).\n");
+        fprintf(stderr, "  -y <ydim>:      Y dimension of the media in 1/1000 inch (optional, default is 2540).\n");
+        fprintf(stderr, "  -t <tracking>:  Media Tracking (mark, continuous, gap) (optional, default is mark).\n");
+        fprintf(stderr, "  -S:             Strict preflight: fail instead of using the nearest supported media, speed, etc. (optional).\n");
+        fprintf(stderr, "  -U <username>:  Username for authentication (optional).\n");
+        fprintf(stderr, "  -P <password>:  Password for authentication (optional).\n");
+        fprintf(stderr, "  -a:             Enable authentication (use with -U and -P).\n");
+        return false;
+    }
+
+    if (params->use_auth && (!params->username || !params->password)) {
+        fprintf(stderr, "Error: Authentication enabled (-a) but username (-U) and/or password (-P) are missing.\n");
+        return false;
+    }
+
+    if (params->workers < 1) {
+        params->workers = 1;
+    } else if (params->workers > MAX_WORKERS) {
+        params->workers = MAX_WORKERS;
+    }
+
+    return true;
+}
+
+// --- Function to establish IPP connection (from print-mon.c) ---
+http_t *establish_ipp_connection(const char *hostname, int port) {
+    http_t *http = httpConnect(hostname, port, NULL, AF_UNSPEC, HTTP_ENCRYPTION_ALWAYS, 1, 30000, NULL);
+    if (!http) {
+        fprintf(stderr, "Error: Unable to connect to printer at %s:%d: %s\n", hostname, port, cupsGetErrorString());
+    }
+    return http;
+}
+
+// --- Function to handle authentication (from print-mon.c) ---
+bool handle_authentication(http_t *http, const char *username, const char *password) {
+    char credentials[CREDENTIALS_MAX];
+    snprintf(credentials, sizeof(credentials), "%s:%s", username, password);
+    char *auth_string = base64Encoder(credentials, strlen(credentials));
+    if (!auth_string) {
+        fprintf(stderr, "Error: base64 encoding failure!\n");
+        return false;
+    }
+    httpSetAuthString(http, "Basic", auth_string);
+    free(auth_string);
+    return true;
+}
+
+// --- Function to create IPP print job request (from print-mon.c) ---
+ipp_t *create_print_job_request(const BatchParams *params, const char *printer_uri_str, const char *job_name) {
+    ipp_t *request = ippNewRequest(IPP_OP_PRINT_JOB);
+    if (!request) {
+        fprintf(stderr, "Error: Could not create IPP request.\n");
+        return NULL;
+    }
+
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri_str);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "job-name", NULL, job_name);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE, "document-format", NULL, params->filetype);
+
+    // --- Constructing media-col collection - media-size ---
+    ipp_t *media_col = ippNew();
+    ippAddString(media_col, IPP_TAG_JOB, IPP_TAG_KEYWORD, "media-type", NULL, "labels-continuous");
+    ippAddString(media_col, IPP_TAG_JOB, IPP_TAG_KEYWORD, "media-source", NULL, "main");
+
+    ipp_t *media_size = ippNew();
+    ippAddInteger(media_size, IPP_TAG_JOB, IPP_TAG_INTEGER, "x-dimension", params->x_dimension);
+    ippAddInteger(media_size, IPP_TAG_JOB, IPP_TAG_INTEGER, "y-dimension", params->y_dimension);
+    ippAddCollection(media_col, IPP_TAG_JOB, "media-size", media_size);
+    ippDelete(media_size);
+
+    ippAddInteger(media_col, IPP_TAG_JOB, IPP_TAG_INTEGER, "media-bottom-margin", 0);
+    ippAddInteger(media_col, IPP_TAG_JOB, IPP_TAG_INTEGER, "media-left-margin", 0);
+    ippAddInteger(media_col, IPP_TAG_JOB, IPP_TAG_INTEGER, "media-right-margin", 0);
+    ippAddInteger(media_col, IPP_TAG_JOB, IPP_TAG_INTEGER, "media-top-margin", 0);
+    ippAddInteger(media_col, IPP_TAG_JOB, IPP_TAG_INTEGER, "media-top-offset", 0);
+    ippAddString(media_col, IPP_TAG_JOB, IPP_TAG_KEYWORD, "media-tracking", NULL, params->media_tracking);
+    ippAddCollection(request, IPP_TAG_JOB, "media-col", media_col);
+    ippDelete(media_col);
+    // --- media-col construction complete ---
+
+    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-darkness", params->darkness);
+    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-speed", params->speed);
+    ippAddString(request, IPP_TAG_JOB, IPP_TAG_KEYWORD, "print-color-mode", NULL, "monochrome");
+    ippAddResolution(request, IPP_TAG_JOB, "printer-resolution", IPP_RES_PER_INCH, params->resolution, params->resolution);
+
+    return request;
+}
+
+// --- Function to read a whole file into a NUL-terminated buffer ---
+char *read_file(const char *filename, size_t *length) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Unable to open %s.\n", filename);
+        return NULL;
+    }
+
+    size_t size = 0, alloc = 65536;
+    char *buffer = malloc(alloc);
+    size_t bytes;
+    while (buffer && (bytes = fread(buffer + size, 1, alloc - size - 1, fp)) > 0) {
+        size += bytes;
+        if (size + 1 == alloc) {
+            char *grown = realloc(buffer, alloc * 2);
+            if (!grown) {
+                free(buffer);
+                buffer = NULL;
+                break;
+            }
+            buffer = grown;
+            alloc *= 2;
+        }
+    }
+    fclose(fp);
+
+    if (!buffer) {
+        fprintf(stderr, "Error: Out of memory reading %s.\n", filename);
+        return NULL;
+    }
+    buffer[size] = '\0';
+    *length = size;
+    return buffer;
+}
+
+// --- Function to load a CSV/TSV data file (RFC 4180 quoting, fields split in place) ---
+bool load_data_file(const char *filename, char delimiter, DataFile *data) {
+    memset(data, 0, sizeof(*data));
+
+    size_t length;
+    if ((data->buffer = read_file(filename, &length)) == NULL) {
+        return false;
+    }
+
+    if (!delimiter) {
+        size_t header = strcspn(data->buffer, "\r\n");
+        delimiter = memchr(data->buffer, '\t', header) ? '\t' : ',';
+    }
+
+    size_t alloc_fields = 0, num_fields = 0, column = 0;
+    char *in = data->buffer, *out = data->buffer, *end = data->buffer + length;
+    bool header = true;
+
+    while (in < end) {
+        // Parse one field, unquoting in place
+        char *field = out;
+        if (*in == '"') {
+            for (in++; in < end; in++) {
+                if (*in == '"') {
+                    if (in + 1 < end && in[1] == '"') {
+                        in++;
+                    } else {
+                        in++;
+                        break;
+                    }
+                }
+                *out++ = *in;
+            }
+        }
+        while (in < end && *in != delimiter && *in != '\r' && *in != '\n') {
+            *out++ = *in++;
+        }
+
+        bool end_of_record = (in >= end || *in != delimiter);
+        if (in < end && *in == '\r') in++;
+        if (in < end) in++;
+        *out++ = '\0';
+
+        // Skip blank lines
+        if (end_of_record && column == 0 && !*field) {
+            continue;
+        }
+
+        if (header) {
+            if (column >= MAX_COLUMNS) {
+                fprintf(stderr, "Error: %s has more than %d columns.\n", filename, MAX_COLUMNS);
+                free(data->buffer);
+                return false;
+            }
+            data->columns[column] = field;
+            data->num_columns = column + 1;
+        } else if (column < data->num_columns) {
+            if (num_fields >= alloc_fields) {
+                alloc_fields = alloc_fields ? alloc_fields * 2 : 1024 * data->num_columns;
+                char **grown = realloc(data->fields, alloc_fields * sizeof(char *));
+                if (!grown) {
+                    fprintf(stderr, "Error: Out of memory reading %s.\n", filename);
+                    free(data->fields);
+                    free(data->buffer);
+                    return false;
+                }
+                data->fields = grown;
+            }
+            data->fields[num_fields++] = field;
+        }
+        column++;
+
+        if (end_of_record) {
+            // Short records get empty trailing fields
+            while (!header && column < data->num_columns) {
+                if (num_fields >= alloc_fields) {
+                    alloc_fields *= 2;
+                    char **grown = realloc(data->fields, alloc_fields * sizeof(char *));
+                    if (!grown) {
+                        fprintf(stderr, "Error: Out of memory reading %s.\n", filename);
+                        free(data->fields);
+                        free(data->buffer);
+                        return false;
+                    }
+                    data->fields = grown;
+                }
+                data->fields[num_fields++] = out - 1;
+                column++;
+            }
+            header = false;
+            column = 0;
+        }
+    }
+
+    if (data->num_columns == 0) {
+        fprintf(stderr, "Error: %s has no header line.\n", filename);
+        free(data->buffer);
+        return false;
+    }
+
+    data->num_records = num_fields / data->num_columns;
+    return true;
+}
+
+// --- Function to load a label template and resolve its {{column}} references ---
+bool load_template(const char *filename, const DataFile *data, LabelTemplate *tmpl) {
+    memset(tmpl, 0, sizeof(*tmpl));
+
+    size_t length;
+    if ((tmpl->buffer = read_file(filename, &length)) == NULL) {
+        return false;
+    }
+
+    // Every reference splits a literal, so this bounds the segment count
+    size_t alloc = 1;
+    for (const char *ptr = tmpl->buffer; (ptr = strstr(ptr, "{{")) != NULL; ptr += 2) {
+        alloc += 2;
+    }
+    if ((tmpl->segments = calloc(alloc, sizeof(TemplateSegment))) == NULL) {
+        fprintf(stderr, "Error: Out of memory reading %s.\n", filename);
+        free(tmpl->buffer);
+        return false;
+    }
+
+    char *ptr = tmpl->buffer;
+    while (*ptr) {
+        char *start = strstr(ptr, "{{");
+        char *finish = start ? strstr(start + 2, "}}") : NULL;
+
+        if (!finish) {
+            start = ptr + strlen(ptr);
+        }
+        if (start > ptr) {
+            TemplateSegment *seg = &tmpl->segments[tmpl->num_segments++];
+            seg->text = ptr;
+            seg->length = (size_t)(start - ptr);
+            seg->column = -1;
+        }
+        if (!finish) {
+            break;
+        }
+
+        // Column names are matched exactly after trimming surrounding spaces
+        char *name = start + 2, *name_end = finish;
+        while (name < name_end && isspace((unsigned char)*name)) name++;
+        while (name_end > name && isspace((unsigned char)name_end[-1])) name_end--;
+
+        size_t column;
+        for (column = 0; column < data->num_columns; column++) {
+            if (strlen(data->columns[column]) == (size_t)(name_end - name) &&
+                !strncmp(data->columns[column], name, (size_t)(name_end - name))) {
+                break;
+            }
+        }
+        if (column >= data->num_columns) {
+            fprintf(stderr, "Error: Template field \"%.*s\" is not a column in the data file.\n", (int)(name_end - name), name);
+            free(tmpl->segments);
+            free(tmpl->buffer);
+            return false;
+        }
+
+        TemplateSegment *seg = &tmpl->segments[tmpl->num_segments++];
+        seg->column = (int)column;
+        ptr = finish + 2;
+    }
+
+    return true;
+}
+
+// --- Function to render one record into a print-ready document ---
+char *render_label(const LabelTemplate *tmpl, const DataFile *data, size_t record, size_t *length) {
+    char **fields = data->fields + record * data->num_columns;
+    size_t size = 0;
+
+    for (size_t i = 0; i < tmpl->num_segments; i++) {
+        const TemplateSegment *seg = &tmpl->segments[i];
+        size += seg->text ? seg->length : strlen(fields[seg->column]);
+    }
+
+    char *label = malloc(size + 1);
+    if (!label) {
+        return NULL;
+    }
+
+    char *ptr = label;
+    for (size_t i = 0; i < tmpl->num_segments; i++) {
+        const TemplateSegment *seg = &tmpl->segments[i];
+        const char *text = seg->text ? seg->text : fields[seg->column];
+        size_t len = seg->text ? seg->length : strlen(text);
+        memcpy(ptr, text, len);
+        ptr += len;
+    }
+    *ptr = '\0';
+
+    *length = size;
+    return label;
+}
+
+// --- Render worker thread ---
+void *render_worker(void *arg) {
+    RenderPipeline *pipeline = (RenderPipeline *)arg;
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (!pipeline->abort && pipeline->next_render < pipeline->data->num_records) {
+        size_t record = pipeline->next_render;
+
+        // Don't get more than a window ahead of the submitter
+        if (record >= pipeline->next_submit + pipeline->window) {
+            pthread_cond_wait(&pipeline->submitted, &pipeline->lock);
+            continue;
+        }
+        pipeline->next_render++;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        size_t length = 0;
+        char *label = render_label(pipeline->tmpl, pipeline->data, record, &length);
+
+        pthread_mutex_lock(&pipeline->lock);
+        RenderedLabel *slot = &pipeline->slots[record % pipeline->window];
+        slot->data = label;
+        slot->length = length;
+        slot->ready = true;
+        pthread_cond_signal(&pipeline->rendered);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return NULL;
+}
+
+// --- Function to submit one rendered label, returns the job ID or 0 on failure ---
+int submit_label(http_t *http, const BatchParams *params, const char *printer_uri_str, size_t record, const char *data, size_t length) {
+    char job_name[JOB_NAME_MAX];
+    snprintf(job_name, sizeof(job_name), "label-%zu", record + 1);
+
+    ipp_t *request = create_print_job_request(params, printer_uri_str, job_name);
+    if (!request) {
+        return 0;
+    }
+
+    ipp_t *response = NULL;
+    http_status_t status = cupsSendRequest(http, request, "/ipp/print", CUPS_LENGTH_VARIABLE);
+    if (status == HTTP_STATUS_CONTINUE) {
+        status = cupsWriteRequestData(http, data, length);
+    }
+    if (status == HTTP_STATUS_CONTINUE) {
+        response = cupsGetResponse(http, "/ipp/print");
+    } else {
+        httpFlush(http);
+    }
+    ippDelete(request);
+
+    if (!response) {
+        fprintf(stderr, "Error sending print request for record %zu: %s\n", record + 1, cupsGetErrorString());
+        return 0;
+    }
+
+    ipp_status_t status_code = ippGetStatusCode(response);
+    if (status_code > IPP_STATUS_OK_CONFLICTING) {
+        fprintf(stderr, "Print job submission failed for record %zu: %s\n", record + 1, cupsGetErrorString());
+        // The cached capabilities let a bad job through, so fetch them again next time
+        if (status_code == IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES || status_code == IPP_STATUS_ERROR_DOCUMENT_FORMAT_NOT_SUPPORTED) {
+            preflight_invalidate(params->hostname, params->port);
+        }
+        ippDelete(response);
+        return 0;
+    }
+
+    int job_id = ippGetInteger(ippFindAttribute(response, "job-id", IPP_TAG_INTEGER), 0);
+    fprintf(stdout, "Record %zu submitted successfully, job ID: %d\n", record + 1, job_id);
+    ippDelete(response);
+
+    return job_id;
+}
+
+// --- Base64 encoding function (from printLabel.c) ---
+char *base64Encoder(const char *data, size_t input_length) {
+    const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t output_length = (size_t)(4.0 * ceil((double)input_length / 3.0));
+    char *encoded_data = malloc(output_length + 1);
+    if (!encoded_data) return NULL;
+
+    size_t i, j;
+    for (i = 0, j = 0; i < input_length;) {
+        uint32_t octet_a = i < input_length ? (unsigned char)data[i++] : 0;
+        uint32_t octet_b = i < input_length ? (unsigned char)data[i++] : 0;
+        uint32_t octet_c = i < input_length ? (unsigned char)data[i++] : 0;
+
+        uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
+
+        encoded_data[j++] = base64_chars[(triple >> 3 * 6) & 0x3F];
+        encoded_data[j++] = base64_chars[(triple >> 2 * 6) & 0x3F];
+        encoded_data[j++] = base64_chars[(triple >> 1 * 6) & 0x3F];
+        encoded_data[j++] = base64_chars[(triple >> 0 * 6) & 0x3F];
+    }
+
+    for (int i = 0; i < (int)(3 - input_length % 3) % 3; i++) {
+        encoded_data[output_length - 1 - i] = '=';
+    }
+
+    encoded_data[output_length] = '\0';
+    return encoded_data;
+}
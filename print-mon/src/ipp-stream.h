@@ -0,0 +1,64 @@
+#ifndef IPP_STREAM_H
+#define IPP_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <libcups3/cups/cups.h>
+
+// Same module in get-state, print-mon and status-board; keep the copies in sync
+
+#define IPP_STREAM_MAX_ATTRS 8      // Attributes one response can pick out
+#define IPP_STREAM_MAX_VALUES 8     // Values kept per attribute
+#define IPP_STREAM_VALUE_MAX 128    // Bytes kept per value, including the terminating nul
+#define IPP_STREAM_NAME_MAX 64      // Longer attribute names can't be requested
+
+// --- One requested attribute; only its first occurrence in the response is kept ---
+typedef struct {
+    const char *name;
+    ipp_tag_t   value_tag;                                  // IPP_TAG_ZERO if the response didn't have it
+    int         num_values;                                 // Values in the response, may exceed IPP_STREAM_MAX_VALUES
+    int         integers[IPP_STREAM_MAX_VALUES];            // integer, enum and boolean values; first field of range and resolution
+    char        strings[IPP_STREAM_MAX_VALUES][IPP_STREAM_VALUE_MAX]; // Other values as raw bytes, nul-terminated and truncated to fit
+    size_t      lengths[IPP_STREAM_MAX_VALUES];             // Bytes in strings[], an octetString may contain nuls
+} IppStreamAttr;
+
+// --- Status and requested attributes of one response, parsed as the bytes arrive ---
+// Everything lives in the struct, so a response costs no heap allocation at all.
+typedef struct {
+    ipp_status_t   status;
+    int            request_id;
+    http_status_t  http_status;
+    IppStreamAttr  attrs[IPP_STREAM_MAX_ATTRS];
+    int            num_attrs;
+
+    // Parser state, private to ipp-stream.c
+    int            state;
+    unsigned char  scratch[8];                              // Header and length fields
+    size_t         have;
+    ipp_tag_t      tag;
+    char           name[IPP_STREAM_NAME_MAX];
+    size_t         name_length;
+    IppStreamAttr *current;                                 // Attribute the next values belong to, NULL to skip them
+    int            depth;                                   // Collection nesting; members are skipped
+    unsigned char  value[IPP_STREAM_VALUE_MAX + IPP_STREAM_NAME_MAX + 4]; // Room for a language tag too
+    size_t         value_length;
+    size_t         value_have;
+} IppStreamResponse;
+
+// Sets up resp to pick out the named attributes, at most IPP_STREAM_MAX_ATTRS; names must outlive resp
+void ipp_stream_init(IppStreamResponse *resp, const char * const *names, int num_names);
+
+// Parses the next length bytes of an IPP response. Returns true once the whole message has been seen.
+bool ipp_stream_feed(IppStreamResponse *resp, const unsigned char *data, size_t length);
+
+// Sends a request without document data and parses the response straight off the connection.
+// Returns false if the response couldn't be read; the IPP status is left to the caller.
+bool ipp_stream_do_request(http_t *http, ipp_t *request, const char *resource, IppStreamResponse *resp);
+
+// Returns the named attribute if the response had it, otherwise NULL
+const IppStreamAttr *ipp_stream_find(const IppStreamResponse *resp, const char *name);
+
+// Describes why ipp_stream_do_request failed, or the IPP status if it didn't
+const char *ipp_stream_error_string(const IppStreamResponse *resp);
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "job-log.h"
+
+#define LOG_PATH_MAX 1024
+
+// The file format depends on these
+_Static_assert(sizeof(JobLogHeader) == 64, "JobLogHeader must be 64 bytes");
+_Static_assert(sizeof(JobLogRecord) == 64, "JobLogRecord must be 64 bytes");
+
+// Bit n of JobLogRecord.reasons is job_log_reasons[n]
+const char * const job_log_reasons[15] = {
+    "job-completed-successfully",
+    "job-completed-with-warnings",
+    "job-completed-with-errors",
+    "job-canceled-by-user",
+    "job-canceled-by-operator",
+    "job-canceled-at-device",
+    "aborted-by-system",
+    "document-format-error",
+    "document-unprintable-error",
+    "compression-error",
+    "printer-stopped",
+    "job-printing",
+    "job-queued",
+    "job-incoming",
+    "processing-to-stop-point"
+};
+
+// --- Function to open a log for appending, writing the header if it is new ---
+int job_log_open(const char *path) {
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0) {
+        JobLogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, JOB_LOG_MAGIC, sizeof(header.magic));
+        header.version = JOB_LOG_VERSION;
+        header.record_size = sizeof(JobLogRecord);
+        if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+            int saved = errno;
+            close(fd);
+            unlink(path);
+            errno = saved;
+            return -1;
+        }
+        return fd;
+    } else if (errno != EEXIST) {
+        return -1;
+    }
+
+    // Existing log: only append to one this version can read back
+    fd = open(path, O_RDWR | O_APPEND);
+    if (fd < 0) {
+        return -1;
+    }
+    JobLogHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, JOB_LOG_MAGIC, sizeof(header.magic)) || header.version != JOB_LOG_VERSION ||
+        header.record_size != sizeof(JobLogRecord)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    return fd;
+}
+
+// --- Function to append one record ---
+bool job_log_append(int fd, const JobLogRecord *record) {
+    // O_APPEND makes each write land whole at the end, even with other print-mon processes
+    return write(fd, record, sizeof(*record)) == (ssize_t)sizeof(*record);
+}
+
+// --- Function to fill in the printer name and hash ---
+void job_log_set_printer(JobLogRecord *record, const char *hostname, int port) {
+    char name[LOG_PATH_MAX];
+    snprintf(name, sizeof(name), "%s:%d", hostname, port);
+
+    // FNV-1a over the full name, so truncated names still group apart
+    uint32_t hash = 2166136261u;
+    for (const char *ptr = name; *ptr; ptr++) {
+        hash = (hash ^ (unsigned char)*ptr) * 16777619u;
+    }
+    record->printer_hash = hash;
+
+    size_t length = strlen(name);
+    memset(record->printer, 0, sizeof(record->printer));
+    memcpy(record->printer, name, length < sizeof(record->printer) ? length : sizeof(record->printer));
+}
+
+// --- Function to map a job-state-reasons keyword to its bit ---
+uint16_t job_log_reason_bit(const char *reason) {
+    if (!strcmp(reason, "none")) {
+        return 0;
+    }
+    for (int i = 0; i < (int)(sizeof(job_log_reasons) / sizeof(job_log_reasons[0])); i++) {
+        if (!strcmp(reason, job_log_reasons[i])) {
+            return (uint16_t)(1u << i);
+        }
+    }
+    return JOB_REASON_OTHER;
+}
+
+// --- Function to build $XDG_STATE_HOME/cups-demo/job-timeline.log, creating the directory ---
+bool job_log_default_path(char *path, size_t pathsize) {
+    char base[LOG_PATH_MAX];
+    const char *xdg = getenv("XDG_STATE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg && *xdg) {
+        snprintf(base, sizeof(base), "%s", xdg);
+    } else if (home && *home) {
+        snprintf(base, sizeof(base), "%s/.local", home);
+        mkdir(base, 0700);
+        snprintf(base, sizeof(base), "%s/.local/state", home);
+    } else {
+        return false;
+    }
+
+    mkdir(base, 0700);
+    size_t length = strlen(base);
+    snprintf(base + length, sizeof(base) - length, "/cups-demo");
+    mkdir(base, 0700);
+
+    int written = snprintf(path, pathsize, "%s/job-timeline.log", base);
+    return written >= 0 && (size_t)written < pathsize;
+}
+
+// --- Function to read the wall clock in microseconds ---
+int64_t job_log_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
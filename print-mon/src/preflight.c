@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "preflight.h"
+
+#define CACHE_PATH_MAX 1024
+
+// Everything preflight_check looks at, plus compression-supported for select_compression
+static const char * const capability_attrs[] = {
+    "compression-supported",
+    "document-format-supported",
+    "media-col-database",
+    "media-size-supported",
+    "media-tracking-default",
+    "media-tracking-supported",
+    "print-darkness-supported",
+    "print-speed-supported",
+    "printer-resolution-supported"
+};
+
+static bool cache_path(const char *hostname, int port, bool create, char *path, size_t pathsize);
+static ipp_t *read_cache(const char *path, int max_age);
+static void write_cache(const char *path, ipp_t *caps);
+static int range_distance(int value, int lower, int upper, int *nearest);
+static int dimension_distance(ipp_t *media_size, const char *name, int value, int *nearest);
+static bool resolve(const char *name, int *value, int nearest, bool strict);
+static bool check_media_size(ipp_t *caps, PreflightJob *job, bool strict);
+static bool check_integer(ipp_t *caps, const char *supported, const char *name, int *value, bool strict);
+static bool check_resolution(ipp_t *caps, PreflightJob *job, bool strict);
+
+// --- Function to get the printer capabilities, cached locally for max_age seconds ---
+ipp_t *preflight_get_capabilities(http_t *http, const char *printer_uri_str, const char *hostname, int port, int max_age) {
+    char path[CACHE_PATH_MAX];
+    ipp_t *caps = NULL;
+
+    if (max_age > 0 && cache_path(hostname, port, false, path, sizeof(path))) {
+        caps = read_cache(path, max_age);
+        if (caps) {
+            return caps;
+        }
+    }
+
+    ipp_t *request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+    if (!request) return NULL;
+
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri_str);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "requested-attributes",
+                  sizeof(capability_attrs) / sizeof(capability_attrs[0]), NULL, capability_attrs);
+
+    caps = cupsDoRequest(http, request, "/ipp/print");
+    ippDelete(request);
+    if (!caps) {
+        fprintf(stderr, "Error sending Get-Printer-Attributes request: %s\n", cupsGetErrorString());
+        return NULL;
+    }
+    if (ippGetStatusCode(caps) > IPP_STATUS_OK_CONFLICTING) {
+        fprintf(stderr, "Error getting printer capabilities: %s\n", cupsGetErrorString());
+        ippDelete(caps);
+        return NULL;
+    }
+
+    if (cache_path(hostname, port, true, path, sizeof(path))) {
+        write_cache(path, caps);
+    }
+
+    return caps;
+}
+
+// --- Function to check (and optionally adjust) a job against the printer capabilities ---
+bool preflight_check(ipp_t *caps, PreflightJob *job, bool strict) {
+    bool ok = true;
+
+    // There is no "nearest" document format, so this always fails
+    ipp_attribute_t *attr = ippFindAttribute(caps, "document-format-supported", IPP_TAG_MIMETYPE);
+    if (attr && !ippContainsString(attr, job->document_format)) {
+        fprintf(stderr, "Error: document-format %s is not supported by the printer.\n", job->document_format);
+        ok = false;
+    }
+
+    ok = check_media_size(caps, job, strict) && ok;
+
+    attr = ippFindAttribute(caps, "media-tracking-supported", IPP_TAG_KEYWORD);
+    if (attr && ippGetCount(attr) > 0 && !ippContainsString(attr, job->media_tracking)) {
+        const char *fallback = ippGetString(ippFindAttribute(caps, "media-tracking-default", IPP_TAG_KEYWORD), 0, NULL);
+        if (!fallback || !ippContainsString(attr, fallback)) {
+            fallback = ippGetString(attr, 0, NULL);
+        }
+
+        if (strict) {
+            fprintf(stderr, "Error: media-tracking %s is not supported by the printer (try %s).\n", job->media_tracking, fallback);
+            ok = false;
+        } else {
+            fprintf(stderr, "Warning: media-tracking %s is not supported by the printer, using %s.\n", job->media_tracking, fallback);
+            job->media_tracking = fallback;
+        }
+    }
+
+    // print-darkness-supported is the number of levels; the attribute itself always ranges -100 to 100
+    if (ippFindAttribute(caps, "print-darkness-supported", IPP_TAG_INTEGER) &&
+        (job->darkness < -100 || job->darkness > 100)) {
+        ok = resolve("print-darkness", &job->darkness, job->darkness < 0 ? -100 : 100, strict) && ok;
+    }
+
+    ok = check_integer(caps, "print-speed-supported", "print-speed", &job->speed, strict) && ok;
+    ok = check_resolution(caps, job, strict) && ok;
+
+    return ok;
+}
+
+// --- Function to drop the cached capabilities for a printer ---
+void preflight_invalidate(const char *hostname, int port) {
+    char path[CACHE_PATH_MAX];
+    if (cache_path(hostname, port, false, path, sizeof(path))) {
+        unlink(path);
+    }
+}
+
+// --- Helper to build $XDG_CACHE_HOME/cups-demo/<host>_<port>.ipp, creating the directory if asked ---
+static bool cache_path(const char *hostname, int port, bool create, char *path, size_t pathsize) {
+    char base[CACHE_PATH_MAX];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg && *xdg) {
+        snprintf(base, sizeof(base), "%s", xdg);
+    } else if (home && *home) {
+        snprintf(base, sizeof(base), "%s/.cache", home);
+    } else {
+        return false;
+    }
+
+    if (create) {
+        mkdir(base, 0700);
+    }
+    size_t length = strlen(base);
+    snprintf(base + length, sizeof(base) - length, "/cups-demo");
+    if (create) {
+        mkdir(base, 0700);
+    }
+
+    int written = snprintf(path, pathsize, "%s/%s_%d.ipp", base, hostname, port);
+    if (written < 0 || (size_t)written >= pathsize) {
+        return false;
+    }
+
+    // Keep the host name from escaping the cache directory
+    for (char *ptr = path + strlen(base) + 1; *ptr; ptr++) {
+        if (*ptr == '/') *ptr = '_';
+    }
+
+    return true;
+}
+
+// --- Helper to read cached capabilities if they are fresh enough ---
+static ipp_t *read_cache(const char *path, int max_age) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) || time(NULL) - info.st_mtime > max_age) {
+        close(fd);
+        return NULL;
+    }
+
+    ipp_t *caps = ippNew();
+    if (caps && ippReadFile(fd, caps) != IPP_STATE_DATA) {
+        ippDelete(caps);
+        caps = NULL;
+    }
+    close(fd);
+
+    return caps;
+}
+
+// --- Helper to replace the cache file; a failure just means the next run asks the printer ---
+static void write_cache(const char *path, ipp_t *caps) {
+    char temp[CACHE_PATH_MAX + 16];
+    snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return;
+    }
+
+    ippSetState(caps, IPP_STATE_IDLE);
+    bool written = ippWriteFile(fd, caps) == IPP_STATE_DATA;
+    if (close(fd) || !written || rename(temp, path)) {
+        unlink(temp);
+    }
+}
+
+// --- Helper to measure how far a value is outside lower..upper, and the closest value inside ---
+static int range_distance(int value, int lower, int upper, int *nearest) {
+    if (value < lower) {
+        *nearest = lower;
+        return lower - value;
+    }
+    if (value > upper) {
+        *nearest = upper;
+        return value - upper;
+    }
+    *nearest = value;
+    return 0;
+}
+
+// --- Helper for one media-size dimension, which is an integer or a range for custom sizes ---
+static int dimension_distance(ipp_t *media_size, const char *name, int value, int *nearest) {
+    ipp_attribute_t *attr = ippFindAttribute(media_size, name, IPP_TAG_ZERO);
+    int lower, upper;
+
+    if (!attr) {
+        return -1;
+    }
+    if (ippGetValueTag(attr) == IPP_TAG_RANGE) {
+        lower = ippGetRange(attr, 0, &upper);
+    } else {
+        lower = upper = ippGetInteger(attr, 0);
+    }
+
+    return range_distance(value, lower, upper, nearest);
+}
+
+// --- Helper to refuse an unsupported value, or replace it with the nearest supported one ---
+static bool resolve(const char *name, int *value, int nearest, bool strict) {
+    if (strict) {
+        fprintf(stderr, "Error: %s %d is not supported by the printer (nearest is %d).\n", name, *value, nearest);
+        return false;
+    }
+
+    fprintf(stderr, "Warning: %s %d is not supported by the printer, using %d.\n", name, *value, nearest);
+    *value = nearest;
+    return true;
+}
+
+// --- Helper to match media-size against media-col-database, or media-size-supported without one ---
+static bool check_media_size(ipp_t *caps, PreflightJob *job, bool strict) {
+    ipp_attribute_t *attr = ippFindAttribute(caps, "media-col-database", IPP_TAG_BEGIN_COLLECTION);
+    bool database = attr != NULL;
+    if (!database) {
+        attr = ippFindAttribute(caps, "media-size-supported", IPP_TAG_BEGIN_COLLECTION);
+    }
+
+    int best = -1, best_x = 0, best_y = 0;
+    size_t count = ippGetCount(attr);
+    for (size_t i = 0; i < count && best != 0; i++) {
+        ipp_t *media_size = ippGetCollection(attr, i);
+        if (database) {
+            media_size = ippGetCollection(ippFindAttribute(media_size, "media-size", IPP_TAG_BEGIN_COLLECTION), 0);
+        }
+        if (!media_size) {
+            continue;
+        }
+
+        int x, y;
+        int dx = dimension_distance(media_size, "x-dimension", job->x_dimension, &x);
+        int dy = dimension_distance(media_size, "y-dimension", job->y_dimension, &y);
+        if (dx < 0 || dy < 0) {
+            continue;
+        }
+        if (best < 0 || dx + dy < best) {
+            best = dx + dy;
+            best_x = x;
+            best_y = y;
+        }
+    }
+
+    if (best <= 0) {
+        return true;
+    }
+
+    if (strict) {
+        fprintf(stderr, "Error: media-size %dx%d is not supported by the printer (nearest is %dx%d).\n",
+                job->x_dimension, job->y_dimension, best_x, best_y);
+        return false;
+    }
+
+    fprintf(stderr, "Warning: media-size %dx%d is not supported by the printer, using %dx%d.\n",
+            job->x_dimension, job->y_dimension, best_x, best_y);
+    job->x_dimension = best_x;
+    job->y_dimension = best_y;
+    return true;
+}
+
+// --- Helper to check an integer against a 1setOf (integer | rangeOfInteger) attribute ---
+static bool check_integer(ipp_t *caps, const char *supported, const char *name, int *value, bool strict) {
+    ipp_attribute_t *attr = ippFindAttribute(caps, supported, IPP_TAG_ZERO);
+    ipp_tag_t tag = ippGetValueTag(attr);
+    if (!attr || (tag != IPP_TAG_INTEGER && tag != IPP_TAG_RANGE)) {
+        return true;
+    }
+
+    int best = -1, best_value = *value;
+    size_t count = ippGetCount(attr);
+    for (size_t i = 0; i < count && best != 0; i++) {
+        int lower, upper, nearest;
+        if (tag == IPP_TAG_RANGE) {
+            lower = ippGetRange(attr, i, &upper);
+        } else {
+            lower = upper = ippGetInteger(attr, i);
+        }
+
+        int distance = range_distance(*value, lower, upper, &nearest);
+        if (best < 0 || distance < best) {
+            best = distance;
+            best_value = nearest;
+        }
+    }
+
+    return best <= 0 || resolve(name, value, best_value, strict);
+}
+
+// --- Helper to match printer-resolution against the square resolutions the printer offers ---
+static bool check_resolution(ipp_t *caps, PreflightJob *job, bool strict) {
+    ipp_attribute_t *attr = ippFindAttribute(caps, "printer-resolution-supported", IPP_TAG_RESOLUTION);
+
+    int best = -1, best_value = job->resolution;
+    size_t count = ippGetCount(attr);
+    for (size_t i = 0; i < count && best != 0; i++) {
+        int yres;
+        ipp_res_t units;
+        int xres = ippGetResolution(attr, i, &yres, &units);
+        if (xres != yres) {
+            continue;
+        }
+        if (units == IPP_RES_PER_CM) {
+            xres = (int)(xres * 2.54 + 0.5);
+        }
+
+        int distance = abs(xres - job->resolution);
+        if (best < 0 || distance < best) {
+            best = distance;
+            best_value = xres;
+        }
+    }
+
+    return best <= 0 || resolve("printer-resolution", &job->resolution, best_value, strict);
+}
@@ -0,0 +1,34 @@
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+#include <stdbool.h>
+#include <libcups3/cups/cups.h>
+
+// Same module in print-mon, print-batch and printLabel; keep the copies in sync
+
+#define PREFLIGHT_CACHE_MAX_AGE 300 // Seconds a locally cached copy of the printer capabilities is trusted
+
+// --- Job settings checked against the printer before any document data is sent ---
+typedef struct {
+    const char *document_format;
+    int         x_dimension;        // media-size, hundredths of millimeters
+    int         y_dimension;
+    const char *media_tracking;
+    int         darkness;           // print-darkness, -100 to 100
+    int         speed;              // print-speed
+    int         resolution;         // printer-resolution, dots per inch
+} PreflightJob;
+
+// Returns the printer capabilities used by preflight_check (and compression-supported),
+// from the local cache when it is at most max_age seconds old, otherwise from the printer
+ipp_t *preflight_get_capabilities(http_t *http, const char *printer_uri_str, const char *hostname, int port, int max_age);
+
+// Checks the job against the capabilities. Unsupported values are moved to the nearest
+// supported value and reported on stderr, unless strict is set. Returns false if the job
+// can't be printed as checked. A capability the printer doesn't report isn't checked.
+bool preflight_check(ipp_t *caps, PreflightJob *job, bool strict);
+
+// Drops the cached capabilities, e.g. after the printer rejected a job that passed preflight
+void preflight_invalidate(const char *hostname, int port);
+
+#endif
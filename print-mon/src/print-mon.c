@@ -1,12 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <errno.h>
 #include <math.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <zlib.h>
 #include <libcups3/cups/cups.h>
+#include "preflight.h"
+#include "ipp-stream.h"
+#include "job-log.h"
 
 // --- Constants ---
 #define PRINTER_URI_MAX 256
@@ -16,6 +23,12 @@
 #define DEFAULT_X_DIMENSION 10160
 #define DEFAULT_Y_DIMENSION 2540
 #define DEFAULT_MEDIA_TRACKING "mark"
+#define DEFAULT_DARKNESS 100
+#define DEFAULT_SPEED 500
+#define DEFAULT_RESOLUTION 203
+#define COMPRESS_CHUNK_SIZE 65536
+#define COMPRESS_QUEUE_DEPTH 4
+#define LOG_PATH_MAX 1024
 
 // --- Structures ---
 typedef struct {
@@ -26,21 +39,49 @@ typedef struct {
     int         x_dimension;
     int         y_dimension;
 	const char *media_tracking;
+    int         darkness;
+    int         speed;
+    int         resolution;
     const char *username;
     const char *password;
     bool        use_auth;
+    bool        no_compression;
+    const char *compression;    // "gzip", "deflate" or NULL
+    bool        strict;         // Fail preflight instead of adjusting to the nearest supported value
+    const char *log_path;       // Job timeline log, NULL for the default
 } PrintParams;
 
+// Compressed chunks handed from the compressor thread to the sender
+typedef struct {
+    FILE           *fp;
+    bool            gzip;
+    unsigned char   chunks[COMPRESS_QUEUE_DEPTH][COMPRESS_CHUNK_SIZE];
+    size_t          lengths[COMPRESS_QUEUE_DEPTH];
+    size_t          produced;
+    size_t          consumed;
+    bool            done;
+    bool            failed;
+    bool            abort;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} CompressStream;
+
 // --- Function Prototypes ---
 char *base64Encoder(const char *data, size_t input_length);
-void print_keyword_attribute(ipp_attribute_t *attr, const char *name);
-void print_enum_attribute(ipp_attribute_t *attr, const char *name);
-ipp_t *get_job_attributes(http_t *http, const char *printer_uri, int job_id);
+void print_keyword_attribute(const IppStreamAttr *attr, const char *name);
+void print_enum_attribute(const IppStreamAttr *attr, const char *name);
+bool get_job_attributes(http_t *http, const char *printer_uri, int job_id, IppStreamResponse *response);
 bool parse_command_line(int argc, char *argv[], PrintParams *params);
 http_t *establish_ipp_connection(const char *hostname, int port);
 ipp_t *create_print_job_request(const PrintParams *params, const char *printer_uri_str);
 bool handle_authentication(http_t *http, const char *username, const char *password);
-ipp_t *get_printer_attributes(http_t *http, const char *printer_uri_str);
+bool get_printer_attributes(http_t *http, const char *printer_uri_str, IppStreamResponse *response);
+const char *select_compression(ipp_t *caps, const char *filetype);
+void *compress_thread(void *arg);
+ipp_t *send_compressed_document(http_t *http, ipp_t *request, const char *resource, FILE *fp, const char *compression);
+int open_job_log(const char *log_path);
+void log_job_event(int log_fd, JobLogRecord *record, int event, int64_t time_us, int job_state, uint16_t reasons);
+uint16_t job_reason_bits(const IppStreamAttr *attr);
 
 int main(int argc, char *argv[]) {
     PrintParams params;
@@ -50,6 +91,9 @@ int main(int argc, char *argv[]) {
     params.x_dimension = DEFAULT_X_DIMENSION;
     params.y_dimension = DEFAULT_Y_DIMENSION;
 	params.media_tracking = DEFAULT_MEDIA_TRACKING;
+    params.darkness = DEFAULT_DARKNESS;
+    params.speed = DEFAULT_SPEED;
+    params.resolution = DEFAULT_RESOLUTION;
 
     // --- Parse command-line arguments ---
     if (!parse_command_line(argc, argv, &params)) {
@@ -74,76 +118,151 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // --- Preflight the job against the printer capabilities before sending the document ---
+    ipp_t *caps = preflight_get_capabilities(http, printer_uri_str, params.hostname, params.port, PREFLIGHT_CACHE_MAX_AGE);
+    if (caps) {
+        PreflightJob job = {params.filetype, params.x_dimension, params.y_dimension, params.media_tracking,
+                            params.darkness, params.speed, params.resolution};
+        if (!preflight_check(caps, &job, params.strict)) {
+            fprintf(stderr, "Error: Job failed preflight, nothing was sent.\n");
+            ippDelete(caps);
+            httpClose(http);
+            return 1;
+        }
+        params.x_dimension = job.x_dimension;
+        params.y_dimension = job.y_dimension;
+        params.media_tracking = job.media_tracking;
+        params.darkness = job.darkness;
+        params.speed = job.speed;
+        params.resolution = job.resolution;
+    } else {
+        fprintf(stderr, "Warning: Printer capabilities unavailable, skipping preflight.\n");
+    }
+
+    // --- Negotiate document compression ---
+    if (!params.no_compression && caps) {
+        params.compression = select_compression(caps, params.filetype);
+    }
+
     // --- Create IPP print job request ---
     ipp_t *request = create_print_job_request(&params, printer_uri_str);
+    ippDelete(caps); // media_tracking may point into caps until the request is built
     if (!request) {
         fprintf(stderr, "Error: Failed to create IPP print job request.\n");
         httpClose(http);
         return 1;
     }
 
+    // --- Open the job timeline log; printing goes ahead without it ---
+    int log_fd = open_job_log(params.log_path);
+    JobLogRecord timeline;
+    memset(&timeline, 0, sizeof(timeline));
+    job_log_set_printer(&timeline, params.hostname, params.port);
+
     // --- Send print request ---
-    ipp_t *response = cupsDoFileRequest(http, request, "/ipp/print", params.filename);
+    ipp_t *response = NULL;
+    if (params.compression) {
+        FILE *fp = fopen(params.filename, "rb");
+        if (!fp) {
+            fprintf(stderr, "Error: Unable to open %s.\n", params.filename);
+            ippDelete(request);
+            httpClose(http);
+            if (log_fd >= 0) close(log_fd);
+            return 1;
+        }
+        timeline.submitted_us = job_log_now();
+        response = send_compressed_document(http, request, "/ipp/print", fp, params.compression);
+        fclose(fp);
+    } else {
+        timeline.submitted_us = job_log_now();
+        response = cupsDoFileRequest(http, request, "/ipp/print", params.filename);
+    }
     if (!response) {
         fprintf(stderr, "Error sending print request: %s\n", cupsGetErrorString());
+        timeline.status = (uint16_t)cupsGetError();
+        log_job_event(log_fd, &timeline, JOB_EVENT_REJECTED, job_log_now(), 0, 0);
         ippDelete(request);
         httpClose(http);
+        if (log_fd >= 0) close(log_fd);
         return 1;
     }
 
     ipp_status_t status = ippGetStatusCode(response);
+    timeline.status = (uint16_t)status;
     if (status > IPP_STATUS_OK) {
         fprintf(stderr, "Print job submission failed: %s\n", cupsGetErrorString());
+        log_job_event(log_fd, &timeline, JOB_EVENT_REJECTED, job_log_now(), 0, 0);
+        // The cached capabilities let a bad job through, so fetch them again next time
+        if (status == IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES || status == IPP_STATUS_ERROR_DOCUMENT_FORMAT_NOT_SUPPORTED) {
+            preflight_invalidate(params.hostname, params.port);
+        }
         ippDelete(response);
         ippDelete(request);
         httpClose(http);
+        if (log_fd >= 0) close(log_fd);
         return 1;
     }
 
     // --- Get job ID ---
     int job_id = ippGetInteger(ippFindAttribute(response, "job-id", IPP_TAG_INTEGER), 0);
     fprintf(stdout, "Print job submitted successfully, job ID: %d\n", job_id);
+    int submitted_state = ippGetInteger(ippFindAttribute(response, "job-state", IPP_TAG_ENUM), 0);
+    timeline.job_id = job_id;
+    log_job_event(log_fd, &timeline, JOB_EVENT_SUBMITTED, timeline.submitted_us, submitted_state, 0);
+
+    // job-stats only counts STATE records, so the first poll always writes one,
+    // even for a job the Print-Job response already reported finished
+    int logged_state = 0;
+    uint16_t logged_reasons = 0;
     ippDelete(response);
     ippDelete(request);
 
     // --- Monitoring loop ---
+    // Responses are parsed in place, so polling allocates nothing per attribute
+    IppStreamResponse job_response, printer_response;
     while (true) {
         printf("\n--- Monitoring Job ID %d and Printer at %s ---\n", job_id, params.hostname);
 
         // --- Get and print job attributes ---
-        ipp_t *job_response = get_job_attributes(http, printer_uri_str, job_id);
-        if (job_response) {
-            print_enum_attribute(ippFindAttribute(job_response, "job-state", IPP_TAG_ENUM), "job-state");
-            print_keyword_attribute(ippFindAttribute(job_response, "job-state-reasons", IPP_TAG_KEYWORD), "job-state-reasons");
+        if (get_job_attributes(http, printer_uri_str, job_id, &job_response)) {
+            const IppStreamAttr *job_state_attr = ipp_stream_find(&job_response, "job-state");
+            const IppStreamAttr *job_reasons_attr = ipp_stream_find(&job_response, "job-state-reasons");
+            print_enum_attribute(job_state_attr, "job-state");
+            print_keyword_attribute(job_reasons_attr, "job-state-reasons");
 
             // Check if the job is completed, canceled, or aborted
-            ipp_attribute_t *job_state_attr = ippFindAttribute(job_response, "job-state", IPP_TAG_ENUM);
-            if (job_state_attr) {
-                ipp_jstate_t job_state = ippGetInteger(job_state_attr, 0);
+            if (job_state_attr && job_state_attr->value_tag == IPP_TAG_ENUM) {
+                ipp_jstate_t job_state = job_state_attr->integers[0];
+
+                // Log transitions only; the time is when this poll saw them
+                uint16_t reasons = job_reason_bits(job_reasons_attr);
+                if ((int)job_state != logged_state || reasons != logged_reasons) {
+                    logged_state = job_state;
+                    logged_reasons = reasons;
+                    log_job_event(log_fd, &timeline, JOB_EVENT_STATE, job_log_now(), logged_state, logged_reasons);
+                }
+
                 if (job_state == IPP_JSTATE_COMPLETED || job_state == IPP_JSTATE_CANCELED || job_state == IPP_JSTATE_ABORTED) {
                     printf("Job is finished. Exiting monitoring.\n");
-                    ippDelete(job_response);
                     break;
                 }
             }
-            ippDelete(job_response);
         } else {
             fprintf(stderr, "Error getting job attributes.\n");
         }
 
         // --- Get and print printer attributes ---
-        ipp_t *printer_response = get_printer_attributes(http, printer_uri_str);
-        if (!printer_response) {
+        if (!get_printer_attributes(http, printer_uri_str, &printer_response)) {
             fprintf(stderr, "Error getting printer attributes.\n");
         } else {
-            print_enum_attribute(ippFindAttribute(printer_response, "printer-state", IPP_TAG_ENUM), "printer-state");
-            print_keyword_attribute(ippFindAttribute(printer_response, "printer-state-reasons", IPP_TAG_KEYWORD), "printer-state-reasons");
-            ippDelete(printer_response);
+            print_enum_attribute(ipp_stream_find(&printer_response, "printer-state"), "printer-state");
+            print_keyword_attribute(ipp_stream_find(&printer_response, "printer-state-reasons"), "printer-state-reasons");
         }
 
         sleep(MONITOR_INTERVAL_DEFAULT); // Wait before checking again
     }
 
+    if (log_fd >= 0) close(log_fd);
     httpClose(http);
     return 0;
 }
@@ -153,7 +272,7 @@ bool parse_command_line(int argc, char *argv[], PrintParams *params) {
     int opt;
     opterr = 0;
 
-    while ((opt = getopt(argc, argv, "h:p:f:m:U:P:ax:y:t:")) != -1) {
+    while ((opt = getopt(argc, argv, "h:p:f:m:U:P:ax:y:t:zSL:")) != -1) {
         switch (opt) {
             case 'h':
                 params->hostname = optarg;
@@ -176,6 +295,15 @@ bool parse_command_line(int argc, char *argv[], PrintParams *params) {
             case 'a':
                 params->use_auth = true;
                 break;
+            case 'z':
+                params->no_compression = true;
+                break;
+            case 'S':
+                params->strict = true;
+                break;
+            case 'L':
+                params->log_path = optarg;
+                break;
             case 'x':
                 params->x_dimension = atoi(optarg);
                 break;
@@ -189,7 +317,7 @@ bool parse_command_line(int argc, char *argv[], PrintParams *params) {
             case '?':
                 if (optopt == 'h' || optopt == 'p' || optopt == 'f' || optopt == 'm' || optopt == 'U' || optopt == 'P')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
-                else if (optopt == 'x' || optopt == 'y' || optopt == 't')
+                else if (optopt == 'x' || optopt == 'y' || optopt == 't' || optopt == 'L')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 else if (isprint(optopt))
                     fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -202,7 +330,7 @@ bool parse_command_line(int argc, char *argv[], PrintParams *params) {
     }
 
     if (!params->hostname || !params->filename || !params->filetype) {
-        fprintf(stderr, "Usage: %s -h <hostname> [-p <port>] -f <filename> -m <mime_type> [-x <xdim>] [-y <ydim>] [-t <tracking>] [-U <username> -P <password> -a]\n", argv[0]);
+        fprintf(stderr, "Usage: %s -h <hostname> [-p <port>] -f <filename> -m <mime_type> [-x <xdim>] [-y <ydim>] [-t <tracking>] [-z] [-S] [-L <logfile>] [-U <username> -P <password> -a]\n", argv[0]);
         fprintf(stderr, "  -h <hostname>:  Hostname or IP address of the printer (required).\n");
         fprintf(stderr, "  -p <port>:      Port number for the printer (optional, default is 631).\n");
         fprintf(stderr, "  -f <filename>:  Path to the file to print (required).\n");
@@ -210,6 +338,9 @@ bool parse_command_line(int argc, char *argv[], PrintParams *params) {
         fprintf(stderr, "  -x <xdim>:      X dimension of the media in 1/1000 inch (optional, default is 10160).\n");
         fprintf(stderr, "  -y <ydim>:      Y dimension of the media in 1/1000 inch (optional, default is 2540).\n");
 		fprintf(stderr, "  -t <tracking>:  Media Tracking (mark, continuous, gap) (optional, default is mark).\n");
+        fprintf(stderr, "  -z:             Don't compress the document even if the printer supports it (optional).\n");
+        fprintf(stderr, "  -S:             Strict preflight: fail instead of using the nearest supported media, speed, etc. (optional).\n");
+        fprintf(stderr, "  -L <logfile>:   Job timeline log for job-stats (optional, default is $XDG_STATE_HOME/cups-demo/job-timeline.log).\n");
         fprintf(stderr, "  -U <username>:  Username for authentication (optional).\n");
         fprintf(stderr, "  -P <password>:  Password for authentication (optional).\n");
         fprintf(stderr, "  -a:             Enable authentication (use with -U and -P).\n");
@@ -259,6 +390,9 @@ ipp_t *create_print_job_request(const PrintParams *params, const char *printer_u
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri_str);
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE, "document-format", NULL, params->filetype);
+    if (params->compression) {
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "compression", NULL, params->compression);
+    }
 
     // --- Constructing media-col collection - media-size ---
     ipp_t *media_col = ippNew();
@@ -281,18 +415,18 @@ ipp_t *create_print_job_request(const PrintParams *params, const char *printer_u
     ippDelete(media_col);
     // --- media-col construction complete ---
 
-    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-darkness", 100);
-    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-speed", 500);
+    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-darkness", params->darkness);
+    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-speed", params->speed);
     ippAddString(request, IPP_TAG_JOB, IPP_TAG_KEYWORD, "print-color-mode", NULL, "monochrome");
-    ippAddResolution(request, IPP_TAG_JOB, "printer-resolution", IPP_RES_PER_INCH, 203, 203);
+    ippAddResolution(request, IPP_TAG_JOB, "printer-resolution", IPP_RES_PER_INCH, params->resolution, params->resolution);
 
     return request;
 }
 
 // --- Function to get printer attributes ---
-ipp_t *get_printer_attributes(http_t *http, const char *printer_uri_str) {
+bool get_printer_attributes(http_t *http, const char *printer_uri_str, IppStreamResponse *response) {
     ipp_t *request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
-    if (!request) return NULL;
+    if (!request) return false;
 
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri_str);
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
@@ -301,15 +435,219 @@ ipp_t *get_printer_attributes(http_t *http, const char *printer_uri_str) {
     ippAddStrings(request, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD),
                   "requested-attributes", 2, NULL, requested_attrs);
 
-    ipp_t *response = cupsDoRequest(http, request, "/ipp/print");
-    if (!response) {
-        fprintf(stderr, "Error sending Get-Printer-Attributes request: %s\n", cupsGetErrorString());
+    ipp_stream_init(response, requested_attrs, 2);
+    bool ok = ipp_stream_do_request(http, request, "/ipp/print", response);
+    if (!ok) {
+        fprintf(stderr, "Error sending Get-Printer-Attributes request: %s\n", ipp_stream_error_string(response));
     }
     ippDelete(request); // Delete request regardless of success
 
+    return ok;
+}
+
+// --- Function to pick a document compression the printer supports, NULL for none ---
+const char *select_compression(ipp_t *caps, const char *filetype) {
+    // Already-compressed formats don't shrink enough to be worth the CPU
+    static const char * const precompressed[] = {
+        "image/jpeg", "image/png", "image/gif", "image/jp2", "image/tiff",
+        "application/gzip", "application/zip", "application/x-gzip"
+    };
+    for (size_t i = 0; i < sizeof(precompressed) / sizeof(precompressed[0]); i++) {
+        if (!strcasecmp(filetype, precompressed[i])) {
+            return NULL;
+        }
+    }
+
+    ipp_attribute_t *attr = ippFindAttribute(caps, "compression-supported", IPP_TAG_KEYWORD);
+    if (attr && ippContainsString(attr, "gzip")) {
+        return "gzip";
+    } else if (attr && ippContainsString(attr, "deflate")) {
+        return "deflate";
+    }
+
+    return NULL;
+}
+
+// --- Compressor thread: deflates the document into the chunk queue ---
+void *compress_thread(void *arg) {
+    CompressStream *cs = (CompressStream *)arg;
+    unsigned char input[COMPRESS_CHUNK_SIZE];
+    z_stream zs;
+    int flush, ret = Z_OK;
+    size_t slot;
+
+    memset(&zs, 0, sizeof(zs));
+    // gzip is RFC 1952 (windowBits + 16); IPP "deflate" is raw RFC 1951 (negative windowBits)
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, cs->gzip ? 15 + 16 : -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        pthread_mutex_lock(&cs->lock);
+        cs->failed = cs->done = true;
+        pthread_cond_broadcast(&cs->cond);
+        pthread_mutex_unlock(&cs->lock);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cs->lock);
+    slot = cs->produced % COMPRESS_QUEUE_DEPTH;
+    pthread_mutex_unlock(&cs->lock);
+    zs.next_out = cs->chunks[slot];
+    zs.avail_out = COMPRESS_CHUNK_SIZE;
+
+    do {
+        zs.avail_in = (uInt)fread(input, 1, sizeof(input), cs->fp);
+        if (ferror(cs->fp)) {
+            ret = Z_ERRNO;
+            break;
+        }
+        flush = feof(cs->fp) ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = input;
+
+        do {
+            ret = deflate(&zs, flush);
+
+            // Hand off each full chunk, waiting while the sender is a full queue behind
+            if (zs.avail_out == 0) {
+                pthread_mutex_lock(&cs->lock);
+                cs->lengths[slot] = COMPRESS_CHUNK_SIZE;
+                cs->produced++;
+                pthread_cond_broadcast(&cs->cond);
+                while (!cs->abort && cs->produced - cs->consumed >= COMPRESS_QUEUE_DEPTH) {
+                    pthread_cond_wait(&cs->cond, &cs->lock);
+                }
+                bool abort = cs->abort;
+                slot = cs->produced % COMPRESS_QUEUE_DEPTH;
+                pthread_mutex_unlock(&cs->lock);
+
+                if (abort) {
+                    deflateEnd(&zs);
+                    return NULL;
+                }
+                zs.next_out = cs->chunks[slot];
+                zs.avail_out = COMPRESS_CHUNK_SIZE;
+            }
+        } while (ret != Z_STREAM_ERROR && (zs.avail_in > 0 || (flush == Z_FINISH && ret != Z_STREAM_END)));
+    } while (ret != Z_STREAM_ERROR && flush != Z_FINISH);
+
+    pthread_mutex_lock(&cs->lock);
+    if (ret == Z_STREAM_END && zs.avail_out < COMPRESS_CHUNK_SIZE) {
+        cs->lengths[slot] = COMPRESS_CHUNK_SIZE - zs.avail_out;
+        cs->produced++;
+    }
+    cs->failed = ret != Z_STREAM_END;
+    cs->done = true;
+    pthread_cond_broadcast(&cs->cond);
+    pthread_mutex_unlock(&cs->lock);
+
+    deflateEnd(&zs);
+    return NULL;
+}
+
+// --- Function to send a print request with the document compressed on the fly ---
+ipp_t *send_compressed_document(http_t *http, ipp_t *request, const char *resource, FILE *fp, const char *compression) {
+    CompressStream *cs = calloc(1, sizeof(CompressStream));
+    if (!cs) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return NULL;
+    }
+    cs->fp = fp;
+    cs->gzip = !strcmp(compression, "gzip");
+    pthread_mutex_init(&cs->lock, NULL);
+    pthread_cond_init(&cs->cond, NULL);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, compress_thread, cs) != 0) {
+        fprintf(stderr, "Error: Unable to start compressor thread.\n");
+        pthread_cond_destroy(&cs->cond);
+        pthread_mutex_destroy(&cs->lock);
+        free(cs);
+        return NULL;
+    }
+
+    // Length isn't known up front, so the request body is chunked
+    http_status_t status = cupsSendRequest(http, request, resource, CUPS_LENGTH_VARIABLE);
+
+    // Send chunks as they are compressed; the compressor keeps working during each write
+    pthread_mutex_lock(&cs->lock);
+    while (status == HTTP_STATUS_CONTINUE) {
+        while (cs->consumed == cs->produced && !cs->done) {
+            pthread_cond_wait(&cs->cond, &cs->lock);
+        }
+        if (cs->consumed == cs->produced) {
+            break;
+        }
+
+        size_t slot = cs->consumed % COMPRESS_QUEUE_DEPTH;
+        pthread_mutex_unlock(&cs->lock);
+        status = cupsWriteRequestData(http, (const char *)cs->chunks[slot], cs->lengths[slot]);
+        pthread_mutex_lock(&cs->lock);
+
+        cs->consumed++;
+        pthread_cond_broadcast(&cs->cond);
+    }
+    bool failed = cs->failed;
+    cs->abort = true;
+    pthread_cond_broadcast(&cs->cond);
+    pthread_mutex_unlock(&cs->lock);
+    pthread_join(thread, NULL);
+
+    ipp_t *response = NULL;
+    if (failed) {
+        fprintf(stderr, "Error: Unable to compress document.\n");
+        httpFlush(http);
+    } else if (status == HTTP_STATUS_CONTINUE) {
+        response = cupsGetResponse(http, resource);
+    } else {
+        httpFlush(http);
+    }
+
+    pthread_cond_destroy(&cs->cond);
+    pthread_mutex_destroy(&cs->lock);
+    free(cs);
+
     return response;
 }
 
+// --- Function to open the job timeline log, -1 (with a warning) if it can't be used ---
+int open_job_log(const char *log_path) {
+    char default_path[LOG_PATH_MAX];
+    if (!log_path) {
+        if (!job_log_default_path(default_path, sizeof(default_path))) {
+            fprintf(stderr, "Warning: No place for the job timeline log, not logging.\n");
+            return -1;
+        }
+        log_path = default_path;
+    }
+
+    int log_fd = job_log_open(log_path);
+    if (log_fd < 0) {
+        fprintf(stderr, "Warning: Unable to open job timeline log %s: %s, not logging.\n", log_path, strerror(errno));
+    }
+    return log_fd;
+}
+
+// --- Function to append one lifecycle event to the job timeline log ---
+void log_job_event(int log_fd, JobLogRecord *record, int event, int64_t time_us, int job_state, uint16_t reasons) {
+    if (log_fd < 0) {
+        return;
+    }
+
+    record->time_us = time_us;
+    record->event = (uint8_t)event;
+    record->job_state = (uint8_t)job_state;
+    record->reasons = reasons;
+    if (!job_log_append(log_fd, record)) {
+        fprintf(stderr, "Warning: Unable to write job timeline log: %s\n", strerror(errno));
+    }
+}
+
+// --- Function to turn job-state-reasons into job-log bits ---
+uint16_t job_reason_bits(const IppStreamAttr *attr) {
+    uint16_t bits = 0;
+    for (int i = 0; attr && i < attr->num_values && i < IPP_STREAM_MAX_VALUES; i++) {
+        bits |= job_log_reason_bit(attr->strings[i]);
+    }
+    return bits;
+}
+
 // --- Base64 encoding function (from printLabel.c) ---
 char *base64Encoder(const char *data, size_t input_length) {
     const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -340,17 +678,12 @@ char *base64Encoder(const char *data, size_t input_length) {
 }
 
 // --- Function to print keyword attributes ---
-void print_keyword_attribute(ipp_attribute_t *attr, const char *name) {
-    if (attr != NULL) {
-        int count = ippGetCount(attr);
+void print_keyword_attribute(const IppStreamAttr *attr, const char *name) {
+    if (attr != NULL && attr->value_tag == IPP_TAG_KEYWORD) {
+        int count = attr->num_values < IPP_STREAM_MAX_VALUES ? attr->num_values : IPP_STREAM_MAX_VALUES;
         printf("%s:\n", name);
         for (int i = 0; i < count; i++) {
-            const char *value = ippGetString(attr, i, NULL);
-            if (value != NULL) {
-                printf("  %s\n", value);
-            } else {
-                printf("  (null)\n");
-            }
+            printf("  %s\n", attr->strings[i]);
         }
     } else {
         printf("%s attribute not found in the response.\n", name);
@@ -358,12 +691,12 @@ void print_keyword_attribute(ipp_attribute_t *attr, const char *name) {
 }
 
 // --- Function to print enum attributes (from get-state.c) ---
-void print_enum_attribute(ipp_attribute_t *attr, const char *name) {
-    if (attr != NULL) {
-        int count = ippGetCount(attr);
+void print_enum_attribute(const IppStreamAttr *attr, const char *name) {
+    if (attr != NULL && attr->value_tag == IPP_TAG_ENUM) {
+        int count = attr->num_values < IPP_STREAM_MAX_VALUES ? attr->num_values : IPP_STREAM_MAX_VALUES;
         printf("%s:\n", name);
         for (int i = 0; i < count; i++) {
-            ipp_jstate_t enum_value = ippGetInteger(attr, i);
+            ipp_jstate_t enum_value = attr->integers[i];
             const char *state_string = "unknown";
 
             //printer-state
@@ -401,9 +734,9 @@ void print_enum_attribute(ipp_attribute_t *attr, const char *name) {
 }
 
 // --- Function to get job attributes ---
-ipp_t *get_job_attributes(http_t *http, const char *printer_uri, int job_id) {
+bool get_job_attributes(http_t *http, const char *printer_uri, int job_id, IppStreamResponse *response) {
     ipp_t *request = ippNewRequest(IPP_OP_GET_JOB_ATTRIBUTES);
-    if (!request) return NULL;
+    if (!request) return false;
 
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri);
     ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", job_id);
@@ -413,14 +746,15 @@ ipp_t *get_job_attributes(http_t *http, const char *printer_uri, int job_id) {
     ippAddStrings(request, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD),
                   "requested-attributes", 2, NULL, requested_attrs);
 
-    ipp_t *response = cupsDoRequest(http, request, "/ipp/print");
+    ipp_stream_init(response, requested_attrs, 2);
+    bool ok = ipp_stream_do_request(http, request, "/ipp/print", response);
 
-    if (!response) {
-        fprintf(stderr, "Error sending Get-Job-Attributes request: %s\n", cupsGetErrorString());
+    if (!ok) {
+        fprintf(stderr, "Error sending Get-Job-Attributes request: %s\n", ipp_stream_error_string(response));
     }
 
     ippDelete(request); // Delete request regardless of success
-    return response;
+    return ok;
 }
 
 
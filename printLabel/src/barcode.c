@@ -0,0 +1,1009 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "barcode.h"
+
+// --- Constants ---
+#define FNC1 -1                     // Function 1 marker in encoder input
+#define MAX_BARCODE_VALUES 2048
+#define CODE128_QUIET_ZONE 10
+#define CODE128_MAX_CODES 256
+#define QR_QUIET_ZONE 4
+#define QR_MAX_VERSION 40
+#define QR_MAX_CODEWORDS 3706
+#define QR_ECC_LEVEL 1              // Index into the tables below: L, M, Q, H
+#define DATAMATRIX_QUIET_ZONE 1
+#define DATAMATRIX_MAX_CODEWORDS 2178
+#define GF_POLY_QR 0x11d
+#define GF_POLY_DATAMATRIX 0x12d
+
+// --- Structures ---
+typedef struct {
+    int            width;           // Modules
+    int            height;          // Modules, 1 for linear symbols
+    int            quiet_zone;      // Modules
+    unsigned char *modules;         // width * height, 1 = dark
+} BarcodeSymbol;
+
+typedef struct {
+    unsigned char *buffer;
+    int            length;          // Bits
+} BitBuffer;
+
+typedef struct {
+    short size;
+    short regions;                  // Data regions per side
+    short data;
+    short ecc;
+    short blocks;
+} DataMatrixSize;
+
+// --- Code 128 bar/space widths, values 0-105 plus stop ---
+static const char *CODE128_PATTERNS[107] = {
+    "212222", "222122", "222221", "121223", "121322", "131222", "122213", "122312", "132212", "221213",
+    "221312", "231212", "112232", "122132", "122231", "113222", "123122", "123221", "223211", "221132",
+    "221231", "213212", "223112", "312131", "311222", "321122", "321221", "312212", "322112", "322211",
+    "212123", "212321", "232121", "111323", "131123", "131321", "112313", "132113", "132311", "211313",
+    "231113", "231311", "112133", "112331", "132131", "113123", "113321", "133121", "313121", "211331",
+    "231131", "213113", "213311", "213131", "311123", "311321", "331121", "312113", "312311", "332111",
+    "314111", "221411", "431111", "111224", "111422", "121124", "121421", "141122", "141221", "112214",
+    "112412", "122114", "122411", "142112", "142211", "241211", "221114", "413111", "241112", "134111",
+    "111242", "121142", "121241", "114212", "124112", "124211", "411212", "421112", "421211", "212141",
+    "214121", "412121", "111143", "111341", "131141", "114113", "114311", "411113", "411311", "113141",
+    "114131", "311141", "411131", "211412", "211214", "211232", "2331112"
+};
+#define CODE128_SHIFT 98
+#define CODE128_CODE_C 99
+#define CODE128_CODE_B 100
+#define CODE128_CODE_A 101
+#define CODE128_FNC1 102
+#define CODE128_START_A 103
+#define CODE128_START_B 104
+#define CODE128_START_C 105
+#define CODE128_STOP 106
+
+// --- QR error correction codewords per block and block counts, by level and version ---
+static const signed char QR_ECC_PER_BLOCK[4][QR_MAX_VERSION + 1] = {
+    {-1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+    {-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30}
+};
+static const signed char QR_NUM_BLOCKS[4][QR_MAX_VERSION + 1] = {
+    {-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4, 6, 6, 6, 6, 7, 8, 8, 9, 9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+    {-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5, 5, 8, 9, 9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+    {-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8, 8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+    {-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81}
+};
+static const int QR_FORMAT_LEVEL_BITS[4] = {1, 0, 3, 2};
+static const char QR_ALPHANUMERIC[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+
+// --- ECC 200 square symbol sizes ---
+static const DataMatrixSize DATAMATRIX_SIZES[] = {
+    { 10, 1,    3,   5,  1}, { 12, 1,    5,   7,  1}, { 14, 1,    8,  10,  1}, { 16, 1,   12,  12,  1},
+    { 18, 1,   18,  14,  1}, { 20, 1,   22,  18,  1}, { 22, 1,   30,  20,  1}, { 24, 1,   36,  24,  1},
+    { 26, 1,   44,  28,  1}, { 32, 2,   62,  36,  1}, { 36, 2,   86,  42,  1}, { 40, 2,  114,  48,  1},
+    { 44, 2,  144,  56,  1}, { 48, 2,  174,  68,  1}, { 52, 2,  204,  84,  2}, { 64, 4,  280, 112,  2},
+    { 72, 4,  368, 144,  4}, { 80, 4,  456, 192,  4}, { 88, 4,  576, 224,  4}, { 96, 4,  696, 272,  4},
+    {104, 4,  816, 336,  6}, {120, 6, 1050, 408,  6}, {132, 6, 1304, 496,  8}, {144, 6, 1558, 620, 10}
+};
+#define DATAMATRIX_NUM_SIZES (int)(sizeof(DATAMATRIX_SIZES) / sizeof(DATAMATRIX_SIZES[0]))
+
+// --- Function Prototypes ---
+static int parse_plain(const char *data, int *values, int max);
+static int parse_gs1(const char *data, int *values, int max);
+static int gs1_fixed_length(const char *ai);
+static unsigned char gf_multiply(unsigned char a, unsigned char b, int poly);
+static void reed_solomon(const unsigned char *data, int length, unsigned char *ecc, int degree, int poly, int first_root);
+static bool code128_encode(const int *values, int count, BarcodeSymbol *symbol);
+static bool qr_encode(const char *data, BarcodeSymbol *symbol);
+static bool datamatrix_encode(const int *values, int count, BarcodeSymbol *symbol);
+
+// --- Function to look up a symbology by name ---
+bool barcode_parse_type(const char *name, BarcodeType *type) {
+    if (!strcasecmp(name, "code128")) *type = BARCODE_CODE128;
+    else if (!strcasecmp(name, "gs1-128")) *type = BARCODE_GS1_128;
+    else if (!strcasecmp(name, "qr")) *type = BARCODE_QR;
+    else if (!strcasecmp(name, "datamatrix")) *type = BARCODE_DATAMATRIX;
+    else if (!strcasecmp(name, "gs1-datamatrix")) *type = BARCODE_GS1_DATAMATRIX;
+    else return false;
+
+    return true;
+}
+
+// --- Function to encode a barcode and draw it on a raster ---
+bool barcode_draw(LabelRaster *raster, BarcodeType type, const char *data, int module_dots) {
+    int values[MAX_BARCODE_VALUES];
+    int count = 0;
+    bool encoded = false;
+    BarcodeSymbol symbol;
+    memset(&symbol, 0, sizeof(symbol));
+
+    switch (type) {
+        case BARCODE_CODE128:
+        case BARCODE_DATAMATRIX:
+            count = parse_plain(data, values, MAX_BARCODE_VALUES);
+            break;
+        case BARCODE_GS1_128:
+        case BARCODE_GS1_DATAMATRIX:
+            count = parse_gs1(data, values, MAX_BARCODE_VALUES);
+            break;
+        case BARCODE_QR:
+            break;
+    }
+    if (count < 0) {
+        return false;
+    }
+
+    switch (type) {
+        case BARCODE_CODE128:
+        case BARCODE_GS1_128:
+            encoded = code128_encode(values, count, &symbol);
+            break;
+        case BARCODE_QR:
+            encoded = qr_encode(data, &symbol);
+            break;
+        case BARCODE_DATAMATRIX:
+        case BARCODE_GS1_DATAMATRIX:
+            encoded = datamatrix_encode(values, count, &symbol);
+            break;
+    }
+    if (!encoded) {
+        free(symbol.modules);
+        return false;
+    }
+
+    // Whole dots per module, including the quiet zone on both sides
+    bool linear = symbol.height == 1;
+    int span_x = symbol.width + 2 * symbol.quiet_zone;
+    int span_y = linear ? 1 : symbol.height + 2 * symbol.quiet_zone;
+    if (module_dots <= 0) {
+        module_dots = raster->width / span_x;
+        if (raster->height / span_y < module_dots) {
+            module_dots = raster->height / span_y;
+        }
+    }
+    if (module_dots < 1 || span_x * module_dots > raster->width || span_y * module_dots > raster->height) {
+        fprintf(stderr, "Error: Barcode (%dx%d modules) does not fit on a %dx%d dot label.\n",
+                span_x, span_y, raster->width, raster->height);
+        free(symbol.modules);
+        return false;
+    }
+
+    // Linear symbols use the full label height less a two module margin top and bottom
+    int row_dots = module_dots;
+    int x0 = (raster->width - symbol.width * module_dots) / 2;
+    int y0 = (raster->height - symbol.height * module_dots) / 2;
+    if (linear) {
+        row_dots = raster->height - 4 * module_dots;
+        if (row_dots < module_dots) {
+            row_dots = raster->height;
+        }
+        y0 = (raster->height - row_dots) / 2;
+    }
+
+    // Fill runs of dark modules one rectangle at a time
+    for (int row = 0; row < symbol.height; row++) {
+        const unsigned char *modules = symbol.modules + (size_t)row * (size_t)symbol.width;
+        for (int col = 0; col < symbol.width;) {
+            if (!modules[col]) {
+                col++;
+                continue;
+            }
+            int run = 1;
+            while (col + run < symbol.width && modules[col + run]) {
+                run++;
+            }
+            raster_fill(raster, x0 + col * module_dots, y0 + row * row_dots, run * module_dots, row_dots);
+            col += run;
+        }
+    }
+
+    free(symbol.modules);
+    return true;
+}
+
+// --- Helper to copy plain text into encoder input ---
+static int parse_plain(const char *data, int *values, int max) {
+    int count = 0;
+    for (const unsigned char *ptr = (const unsigned char *)data; *ptr; ptr++) {
+        if (count >= max) {
+            fprintf(stderr, "Error: Barcode data is too long.\n");
+            return -1;
+        }
+        values[count++] = *ptr;
+    }
+    return count;
+}
+
+// --- Helper to parse "(AI)value..." GS1 element strings, inserting FNC1 where required ---
+static int parse_gs1(const char *data, int *values, int max) {
+    int count = 0;
+    bool need_separator = false;
+    const char *ptr = data;
+
+    values[count++] = FNC1;
+
+    while (*ptr) {
+        char ai[5];
+        int ai_len = 0;
+
+        if (*ptr != '(') {
+            fprintf(stderr, "Error: GS1 data must be written as (AI)value, e.g. (01)09501101530003(10)ABC.\n");
+            return -1;
+        }
+        for (ptr++; isdigit((unsigned char)*ptr) && ai_len < 4; ptr++) {
+            ai[ai_len++] = *ptr;
+        }
+        ai[ai_len] = '\0';
+        if (*ptr != ')' || ai_len < 2) {
+            fprintf(stderr, "Error: Invalid GS1 application identifier in \"%s\".\n", data);
+            return -1;
+        }
+        ptr++;
+
+        const char *value = ptr;
+        while (*ptr && *ptr != '(') {
+            ptr++;
+        }
+        int value_len = (int)(ptr - value);
+        int fixed = gs1_fixed_length(ai);
+        if (value_len == 0 || (fixed && ai_len + value_len != fixed)) {
+            fprintf(stderr, "Error: Wrong data length for GS1 application identifier (%s).\n", ai);
+            return -1;
+        }
+        if (count + 1 + ai_len + value_len > max) {
+            fprintf(stderr, "Error: Barcode data is too long.\n");
+            return -1;
+        }
+
+        if (need_separator) {
+            values[count++] = FNC1;
+        }
+        for (int i = 0; i < ai_len; i++) {
+            values[count++] = ai[i];
+        }
+        for (int i = 0; i < value_len; i++) {
+            values[count++] = (unsigned char)value[i];
+        }
+
+        // Variable length fields need a separator unless they come last
+        need_separator = !fixed;
+    }
+
+    return count;
+}
+
+// --- Helper returning the predefined AI+data length for fixed-length GS1 AIs, 0 if variable ---
+static int gs1_fixed_length(const char *ai) {
+    int prefix = (ai[0] - '0') * 10 + (ai[1] - '0');
+
+    if (prefix == 0) return 20;
+    if (prefix >= 1 && prefix <= 3) return 16;
+    if (prefix == 4) return 18;
+    if (prefix >= 11 && prefix <= 19) return 8;
+    if (prefix == 20) return 4;
+    if (prefix >= 31 && prefix <= 36) return 10;
+    if (prefix == 41) return 16;
+    return 0;
+}
+
+// --- Helper to multiply in GF(256) with the given reduction polynomial ---
+static unsigned char gf_multiply(unsigned char a, unsigned char b, int poly) {
+    int result = 0;
+    for (int i = 7; i >= 0; i--) {
+        result = (result << 1) ^ ((result >> 7) * poly);
+        result ^= ((b >> i) & 1) * a;
+    }
+    return (unsigned char)result;
+}
+
+// --- Helper to compute Reed-Solomon check codewords, generator roots a^first_root.. ---
+static void reed_solomon(const unsigned char *data, int length, unsigned char *ecc, int degree, int poly, int first_root) {
+    unsigned char divisor[256];
+    unsigned char root = 1;
+
+    for (int i = 0; i < first_root; i++) {
+        root = gf_multiply(root, 2, poly);
+    }
+
+    // Generator polynomial, highest coefficient implied
+    memset(divisor, 0, (size_t)degree);
+    divisor[degree - 1] = 1;
+    for (int i = 0; i < degree; i++) {
+        for (int j = 0; j < degree; j++) {
+            divisor[j] = gf_multiply(divisor[j], root, poly);
+            if (j + 1 < degree) {
+                divisor[j] ^= divisor[j + 1];
+            }
+        }
+        root = gf_multiply(root, 2, poly);
+    }
+
+    memset(ecc, 0, (size_t)degree);
+    for (int i = 0; i < length; i++) {
+        unsigned char factor = data[i] ^ ecc[0];
+        memmove(ecc, ecc + 1, (size_t)degree - 1);
+        ecc[degree - 1] = 0;
+        for (int j = 0; j < degree; j++) {
+            ecc[j] ^= gf_multiply(divisor[j], factor, poly);
+        }
+    }
+}
+
+// --- Code 128 ---
+
+// Helper to count consecutive digits starting at index
+static int code128_digit_run(const int *values, int count, int index) {
+    int run = 0;
+    while (index + run < count && values[index + run] >= '0' && values[index + run] <= '9') {
+        run++;
+    }
+    return run;
+}
+
+// Helper to pick code set A or B for the text starting at index
+static int code128_text_set(const int *values, int count, int index) {
+    for (; index < count; index++) {
+        if (values[index] >= 0 && values[index] < 32) return CODE128_CODE_A;
+        if (values[index] >= 96) return CODE128_CODE_B;
+    }
+    return CODE128_CODE_B;
+}
+
+// Helper returning the value of a character in set A or B, -1 if not in the set
+static int code128_value(int set, int c) {
+    if (set == CODE128_CODE_A) {
+        if (c >= 0 && c < 32) return c + 64;
+        if (c >= 32 && c < 96) return c - 32;
+    } else if (c >= 32 && c < 128) {
+        return c - 32;
+    }
+    return -1;
+}
+
+static bool code128_encode(const int *values, int count, BarcodeSymbol *symbol) {
+    int codes[CODE128_MAX_CODES];
+    int num_codes = 0;
+    int set, i = 0;
+
+    for (int j = 0; j < count; j++) {
+        if (values[j] > 127) {
+            fprintf(stderr, "Error: Code 128 data must be ASCII.\n");
+            return false;
+        }
+    }
+
+    // Start in set C for a leading even run of digits, otherwise A or B
+    int first = (count > 0 && values[0] == FNC1) ? 1 : 0;
+    int run = code128_digit_run(values, count, first);
+    if ((run >= 4 || run == count - first) && run >= 2 && run % 2 == 0) {
+        set = CODE128_CODE_C;
+        codes[num_codes++] = CODE128_START_C;
+    } else {
+        set = code128_text_set(values, count, 0);
+        codes[num_codes++] = set == CODE128_CODE_A ? CODE128_START_A : CODE128_START_B;
+    }
+
+    while (i < count) {
+        if (num_codes + 3 >= CODE128_MAX_CODES) {
+            fprintf(stderr, "Error: Barcode data is too long for Code 128.\n");
+            return false;
+        }
+
+        if (values[i] == FNC1) {
+            codes[num_codes++] = CODE128_FNC1;
+            i++;
+            continue;
+        }
+
+        run = code128_digit_run(values, count, i);
+        if (set == CODE128_CODE_C) {
+            if (run >= 2) {
+                codes[num_codes++] = (values[i] - '0') * 10 + (values[i + 1] - '0');
+                i += 2;
+            } else {
+                set = code128_text_set(values, count, i);
+                codes[num_codes++] = set;
+            }
+            continue;
+        }
+
+        // Switch to set C for four or more digits, odd digit first
+        if (run >= 4) {
+            if (run % 2) {
+                codes[num_codes++] = code128_value(set, values[i++]);
+            }
+            set = CODE128_CODE_C;
+            codes[num_codes++] = CODE128_CODE_C;
+            continue;
+        }
+
+        int value = code128_value(set, values[i]);
+        if (value >= 0) {
+            codes[num_codes++] = value;
+            i++;
+            continue;
+        }
+
+        // Shift for a single character from the other set, latch for more
+        int other = set == CODE128_CODE_A ? CODE128_CODE_B : CODE128_CODE_A;
+        if (i + 1 < count && values[i + 1] != FNC1 && code128_value(set, values[i + 1]) < 0) {
+            set = other;
+            codes[num_codes++] = other;
+        } else {
+            codes[num_codes++] = CODE128_SHIFT;
+            codes[num_codes++] = code128_value(other, values[i++]);
+        }
+    }
+
+    int checksum = codes[0];
+    for (int j = 1; j < num_codes; j++) {
+        checksum += j * codes[j];
+    }
+    codes[num_codes++] = checksum % 103;
+    codes[num_codes++] = CODE128_STOP;
+
+    symbol->width = 11 * num_codes + 2;
+    symbol->height = 1;
+    symbol->quiet_zone = CODE128_QUIET_ZONE;
+    if ((symbol->modules = calloc((size_t)symbol->width, 1)) == NULL) {
+        fprintf(stderr, "Error: Out of memory encoding barcode.\n");
+        return false;
+    }
+
+    // Patterns alternate bar, space, bar... starting with a bar
+    int x = 0;
+    for (int j = 0; j < num_codes; j++) {
+        const char *widths = CODE128_PATTERNS[codes[j]];
+        for (int k = 0; widths[k]; k++) {
+            int width = widths[k] - '0';
+            if (k % 2 == 0) {
+                memset(symbol->modules + x, 1, (size_t)width);
+            }
+            x += width;
+        }
+    }
+
+    return true;
+}
+
+// --- QR Code (ISO/IEC 18004), numeric/alphanumeric/byte mode, level M ---
+
+static void bits_append(BitBuffer *bits, unsigned value, int count) {
+    for (int i = count - 1; i >= 0; i--, bits->length++) {
+        if ((value >> i) & 1) {
+            bits->buffer[bits->length >> 3] |= (unsigned char)(0x80 >> (bits->length & 7));
+        }
+    }
+}
+
+// Helper returning the number of data and error correction bits in a symbol
+static int qr_raw_modules(int version) {
+    int result = (16 * version + 128) * version + 64;
+    if (version >= 2) {
+        int num_align = version / 7 + 2;
+        result -= (25 * num_align - 10) * num_align - 55;
+        if (version >= 7) {
+            result -= 36;
+        }
+    }
+    return result;
+}
+
+static int qr_data_codewords(int version) {
+    return qr_raw_modules(version) / 8 - QR_ECC_PER_BLOCK[QR_ECC_LEVEL][version] * QR_NUM_BLOCKS[QR_ECC_LEVEL][version];
+}
+
+// Helper to list the alignment pattern centres for a version
+static int qr_alignment_positions(int version, int *positions) {
+    if (version == 1) {
+        return 0;
+    }
+
+    int size = version * 4 + 17;
+    int num_align = version / 7 + 2;
+    int step = (version == 32) ? 26 : (version * 4 + num_align * 2 + 1) / (num_align * 2 - 2) * 2;
+
+    positions[0] = 6;
+    for (int i = num_align - 1, pos = size - 7; i >= 1; i--, pos -= step) {
+        positions[i] = pos;
+    }
+    return num_align;
+}
+
+static void qr_set(unsigned char *modules, unsigned char *function, int size, int x, int y, bool dark) {
+    modules[y * size + x] = dark;
+    function[y * size + x] = 1;
+}
+
+static void qr_draw_format(unsigned char *modules, unsigned char *function, int size, int mask) {
+    int data = (QR_FORMAT_LEVEL_BITS[QR_ECC_LEVEL] << 3) | mask;
+    int rem = data;
+    for (int i = 0; i < 10; i++) {
+        rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+    }
+    int bits = ((data << 10) | rem) ^ 0x5412;
+
+    // Around the top left finder
+    for (int i = 0; i <= 5; i++) qr_set(modules, function, size, 8, i, (bits >> i) & 1);
+    qr_set(modules, function, size, 8, 7, (bits >> 6) & 1);
+    qr_set(modules, function, size, 8, 8, (bits >> 7) & 1);
+    qr_set(modules, function, size, 7, 8, (bits >> 8) & 1);
+    for (int i = 9; i < 15; i++) qr_set(modules, function, size, 14 - i, 8, (bits >> i) & 1);
+
+    // Split between the other two finders, plus the dark module
+    for (int i = 0; i < 8; i++) qr_set(modules, function, size, size - 1 - i, 8, (bits >> i) & 1);
+    for (int i = 8; i < 15; i++) qr_set(modules, function, size, 8, size - 15 + i, (bits >> i) & 1);
+    qr_set(modules, function, size, 8, size - 8, true);
+}
+
+static void qr_draw_function_patterns(unsigned char *modules, unsigned char *function, int version) {
+    int size = version * 4 + 17;
+
+    // Timing patterns
+    for (int i = 0; i < size; i++) {
+        qr_set(modules, function, size, 6, i, i % 2 == 0);
+        qr_set(modules, function, size, i, 6, i % 2 == 0);
+    }
+
+    // Finder patterns with separators
+    const int finders[3][2] = {{3, 3}, {size - 4, 3}, {3, size - 4}};
+    for (int f = 0; f < 3; f++) {
+        for (int dy = -4; dy <= 4; dy++) {
+            for (int dx = -4; dx <= 4; dx++) {
+                int x = finders[f][0] + dx, y = finders[f][1] + dy;
+                int dist = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+                if (x >= 0 && x < size && y >= 0 && y < size) {
+                    qr_set(modules, function, size, x, y, dist != 2 && dist != 4);
+                }
+            }
+        }
+    }
+
+    // Alignment patterns, except where they would overlap a finder
+    int positions[7];
+    int num_align = qr_alignment_positions(version, positions);
+    for (int i = 0; i < num_align; i++) {
+        for (int j = 0; j < num_align; j++) {
+            if ((i == 0 && j == 0) || (i == 0 && j == num_align - 1) || (i == num_align - 1 && j == 0)) {
+                continue;
+            }
+            for (int dy = -2; dy <= 2; dy++) {
+                for (int dx = -2; dx <= 2; dx++) {
+                    int dist = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+                    qr_set(modules, function, size, positions[i] + dx, positions[j] + dy, dist != 1);
+                }
+            }
+        }
+    }
+
+    // Reserve the format areas; real bits are drawn once the mask is known
+    qr_draw_format(modules, function, size, 0);
+
+    // Version information
+    if (version >= 7) {
+        int rem = version;
+        for (int i = 0; i < 12; i++) {
+            rem = (rem << 1) ^ ((rem >> 11) * 0x1f25);
+        }
+        long bits = ((long)version << 12) | rem;
+        for (int i = 0; i < 18; i++) {
+            bool bit = (bits >> i) & 1;
+            int a = size - 11 + i % 3, b = i / 3;
+            qr_set(modules, function, size, a, b, bit);
+            qr_set(modules, function, size, b, a, bit);
+        }
+    }
+}
+
+static void qr_apply_mask(unsigned char *modules, const unsigned char *function, int size, int mask) {
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            bool invert;
+            switch (mask) {
+                case 0:  invert = (x + y) % 2 == 0; break;
+                case 1:  invert = y % 2 == 0; break;
+                case 2:  invert = x % 3 == 0; break;
+                case 3:  invert = (x + y) % 3 == 0; break;
+                case 4:  invert = (x / 3 + y / 2) % 2 == 0; break;
+                case 5:  invert = x * y % 2 + x * y % 3 == 0; break;
+                case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0; break;
+                default: invert = ((x + y) % 2 + x * y % 3) % 2 == 0; break;
+            }
+            if (invert && !function[y * size + x]) {
+                modules[y * size + x] ^= 1;
+            }
+        }
+    }
+}
+
+// Helper to score a masked symbol with the four penalty rules; lower is better
+static long qr_penalty(const unsigned char *modules, int size) {
+    static const unsigned char finder_a[11] = {1, 0, 1, 1, 1, 0, 1, 0, 0, 0, 0};
+    static const unsigned char finder_b[11] = {0, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1};
+    long penalty = 0;
+    int dark = 0;
+
+    // Runs of five or more and finder-like patterns, across rows then down columns
+    for (int pass = 0; pass < 2; pass++) {
+        for (int a = 0; a < size; a++) {
+            int run = 0, prev = -1;
+            for (int b = 0; b < size; b++) {
+                int v = pass ? modules[b * size + a] : modules[a * size + b];
+                if (v == prev) {
+                    run++;
+                    if (run == 5) penalty += 3;
+                    else if (run > 5) penalty++;
+                } else {
+                    prev = v;
+                    run = 1;
+                }
+            }
+            for (int b = 0; b + 11 <= size; b++) {
+                bool match_a = true, match_b = true;
+                for (int k = 0; k < 11 && (match_a || match_b); k++) {
+                    int v = pass ? modules[(b + k) * size + a] : modules[a * size + b + k];
+                    match_a = match_a && v == finder_a[k];
+                    match_b = match_b && v == finder_b[k];
+                }
+                penalty += 40 * (match_a + match_b);
+            }
+        }
+    }
+
+    // 2x2 blocks of one colour
+    for (int y = 0; y + 1 < size; y++) {
+        for (int x = 0; x + 1 < size; x++) {
+            int v = modules[y * size + x];
+            if (v == modules[y * size + x + 1] && v == modules[(y + 1) * size + x] && v == modules[(y + 1) * size + x + 1]) {
+                penalty += 3;
+            }
+        }
+    }
+
+    // Balance of dark and light
+    for (int i = 0; i < size * size; i++) {
+        dark += modules[i];
+    }
+    int total = size * size;
+    int k = (abs(dark * 20 - total * 10) + total - 1) / total - 1;
+    penalty += (long)k * 10;
+
+    return penalty;
+}
+
+static bool qr_encode(const char *data, BarcodeSymbol *symbol) {
+    size_t length = strlen(data);
+    int mode, version;
+
+    // Pick the densest mode that covers all of the data
+    bool numeric = length > 0, alphanumeric = length > 0;
+    for (size_t i = 0; i < length; i++) {
+        numeric = numeric && isdigit((unsigned char)data[i]);
+        alphanumeric = alphanumeric && data[i] && strchr(QR_ALPHANUMERIC, data[i]);
+    }
+    mode = numeric ? 1 : alphanumeric ? 2 : 4;
+
+    long payload_bits = mode == 1 ? (long)(length / 3 * 10 + (length % 3 == 2 ? 7 : length % 3 == 1 ? 4 : 0))
+                      : mode == 2 ? (long)(length / 2 * 11 + (length % 2) * 6)
+                      : (long)length * 8;
+
+    // Smallest version that holds the data
+    int count_bits = 0;
+    long total_bits = 0;
+    for (version = 1; version <= QR_MAX_VERSION; version++) {
+        int range = version <= 9 ? 0 : version <= 26 ? 1 : 2;
+        count_bits = mode == 1 ? (int[]){10, 12, 14}[range]
+                   : mode == 2 ? (int[]){9, 11, 13}[range]
+                   : (int[]){8, 16, 16}[range];
+        total_bits = 4 + count_bits + payload_bits;
+        if (length < (1UL << count_bits) && total_bits <= qr_data_codewords(version) * 8L) {
+            break;
+        }
+    }
+    if (version > QR_MAX_VERSION) {
+        fprintf(stderr, "Error: Barcode data is too long for a QR code.\n");
+        return false;
+    }
+
+    // Segment header, data, terminator and pad codewords
+    int data_codewords = qr_data_codewords(version);
+    unsigned char codewords[QR_MAX_CODEWORDS];
+    memset(codewords, 0, sizeof(codewords));
+    BitBuffer bits = {codewords, 0};
+
+    bits_append(&bits, (unsigned)mode, 4);
+    bits_append(&bits, (unsigned)length, count_bits);
+    if (mode == 1) {
+        for (size_t i = 0; i < length; i += 3) {
+            int digits = (int)(length - i < 3 ? length - i : 3);
+            unsigned value = 0;
+            for (int j = 0; j < digits; j++) {
+                value = value * 10 + (unsigned)(data[i + j] - '0');
+            }
+            bits_append(&bits, value, digits * 3 + 1);
+        }
+    } else if (mode == 2) {
+        for (size_t i = 0; i < length; i += 2) {
+            unsigned value = (unsigned)(strchr(QR_ALPHANUMERIC, data[i]) - QR_ALPHANUMERIC);
+            if (i + 1 < length) {
+                value = value * 45 + (unsigned)(strchr(QR_ALPHANUMERIC, data[i + 1]) - QR_ALPHANUMERIC);
+                bits_append(&bits, value, 11);
+            } else {
+                bits_append(&bits, value, 6);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < length; i++) {
+            bits_append(&bits, (unsigned char)data[i], 8);
+        }
+    }
+
+    int capacity = data_codewords * 8;
+    int terminator = capacity - bits.length < 4 ? capacity - bits.length : 4;
+    bits_append(&bits, 0, terminator);
+    bits.length = (bits.length + 7) & ~7;
+    for (int pad = 0xec; bits.length < capacity; pad ^= 0xec ^ 0x11) {
+        bits_append(&bits, (unsigned)pad, 8);
+    }
+
+    // Split into blocks, add error correction and interleave
+    int num_blocks = QR_NUM_BLOCKS[QR_ECC_LEVEL][version];
+    int ecc_len = QR_ECC_PER_BLOCK[QR_ECC_LEVEL][version];
+    int raw_codewords = qr_raw_modules(version) / 8;
+    int num_short = num_blocks - raw_codewords % num_blocks;
+    int short_data = raw_codewords / num_blocks - ecc_len;
+    unsigned char ecc[QR_MAX_CODEWORDS];
+    unsigned char interleaved[QR_MAX_CODEWORDS];
+    int block_start[QR_MAX_VERSION * 2 + 1];
+
+    for (int b = 0, offset = 0; b < num_blocks; b++) {
+        int block_data = short_data + (b >= num_short);
+        block_start[b] = offset;
+        reed_solomon(codewords + offset, block_data, ecc + b * ecc_len, ecc_len, GF_POLY_QR, 0);
+        offset += block_data;
+    }
+
+    int pos = 0;
+    for (int i = 0; i <= short_data; i++) {
+        for (int b = 0; b < num_blocks; b++) {
+            if (i < short_data + (b >= num_short)) {
+                interleaved[pos++] = codewords[block_start[b] + i];
+            }
+        }
+    }
+    for (int i = 0; i < ecc_len; i++) {
+        for (int b = 0; b < num_blocks; b++) {
+            interleaved[pos++] = ecc[b * ecc_len + i];
+        }
+    }
+
+    // Lay out the symbol
+    int size = version * 4 + 17;
+    unsigned char *modules = calloc((size_t)(size * size), 1);
+    unsigned char *function = calloc((size_t)(size * size), 1);
+    if (!modules || !function) {
+        fprintf(stderr, "Error: Out of memory encoding barcode.\n");
+        free(modules);
+        free(function);
+        return false;
+    }
+    qr_draw_function_patterns(modules, function, version);
+
+    // Codewords zigzag up and down two-column strips from the right
+    int bit = 0;
+    for (int right = size - 1; right >= 1; right -= 2) {
+        if (right == 6) {
+            right = 5;
+        }
+        for (int vert = 0; vert < size; vert++) {
+            for (int j = 0; j < 2; j++) {
+                int x = right - j;
+                int y = ((right + 1) & 2) == 0 ? size - 1 - vert : vert;
+                if (!function[y * size + x] && bit < raw_codewords * 8) {
+                    modules[y * size + x] = (interleaved[bit >> 3] >> (7 - (bit & 7))) & 1;
+                    bit++;
+                }
+            }
+        }
+    }
+
+    // Try each mask and keep the one with the lowest penalty
+    int best_mask = 0;
+    long best_penalty = -1;
+    for (int mask = 0; mask < 8; mask++) {
+        qr_apply_mask(modules, function, size, mask);
+        qr_draw_format(modules, function, size, mask);
+        long penalty = qr_penalty(modules, size);
+        if (best_penalty < 0 || penalty < best_penalty) {
+            best_mask = mask;
+            best_penalty = penalty;
+        }
+        qr_apply_mask(modules, function, size, mask);
+    }
+    qr_apply_mask(modules, function, size, best_mask);
+    qr_draw_format(modules, function, size, best_mask);
+
+    free(function);
+    symbol->width = size;
+    symbol->height = size;
+    symbol->quiet_zone = QR_QUIET_ZONE;
+    symbol->modules = modules;
+    return true;
+}
+
+// --- Data Matrix ECC 200 (ISO/IEC 16022), ASCII encodation, square symbols ---
+
+static void datamatrix_module(int *placement, int nrow, int ncol, int row, int col, int chr, int bit) {
+    if (row < 0) {
+        row += nrow;
+        col += 4 - ((nrow + 4) % 8);
+    }
+    if (col < 0) {
+        col += ncol;
+        row += 4 - ((ncol + 4) % 8);
+    }
+    placement[row * ncol + col] = chr * 10 + bit;
+}
+
+static void datamatrix_utah(int *p, int nrow, int ncol, int row, int col, int chr) {
+    datamatrix_module(p, nrow, ncol, row - 2, col - 2, chr, 1);
+    datamatrix_module(p, nrow, ncol, row - 2, col - 1, chr, 2);
+    datamatrix_module(p, nrow, ncol, row - 1, col - 2, chr, 3);
+    datamatrix_module(p, nrow, ncol, row - 1, col - 1, chr, 4);
+    datamatrix_module(p, nrow, ncol, row - 1, col, chr, 5);
+    datamatrix_module(p, nrow, ncol, row, col - 2, chr, 6);
+    datamatrix_module(p, nrow, ncol, row, col - 1, chr, 7);
+    datamatrix_module(p, nrow, ncol, row, col, chr, 8);
+}
+
+// Helper for the four corner shapes, given as (row, col) pairs for bits 1-8
+static void datamatrix_corner(int *p, int nrow, int ncol, const int shape[8][2], int chr) {
+    for (int i = 0; i < 8; i++) {
+        int row = shape[i][0] < 0 ? nrow + shape[i][0] : shape[i][0];
+        int col = shape[i][1] < 0 ? ncol + shape[i][1] : shape[i][1];
+        datamatrix_module(p, nrow, ncol, row, col, chr, i + 1);
+    }
+}
+
+// Helper to assign each mapping matrix module its codeword (value / 10) and bit (value % 10)
+static void datamatrix_place(int *p, int nrow, int ncol) {
+    static const int corner1[8][2] = {{-1, 0}, {-1, 1}, {-1, 2}, {0, -2}, {0, -1}, {1, -1}, {2, -1}, {3, -1}};
+    static const int corner2[8][2] = {{-3, 0}, {-2, 0}, {-1, 0}, {0, -4}, {0, -3}, {0, -2}, {0, -1}, {1, -1}};
+    static const int corner3[8][2] = {{-3, 0}, {-2, 0}, {-1, 0}, {0, -2}, {0, -1}, {1, -1}, {2, -1}, {3, -1}};
+    static const int corner4[8][2] = {{-1, 0}, {-1, -1}, {0, -3}, {0, -2}, {0, -1}, {1, -3}, {1, -2}, {1, -1}};
+    int chr = 1, row = 4, col = 0;
+
+    do {
+        if (row == nrow && col == 0) datamatrix_corner(p, nrow, ncol, corner1, chr++);
+        if (row == nrow - 2 && col == 0 && ncol % 4) datamatrix_corner(p, nrow, ncol, corner2, chr++);
+        if (row == nrow - 2 && col == 0 && ncol % 8 == 4) datamatrix_corner(p, nrow, ncol, corner3, chr++);
+        if (row == nrow + 4 && col == 2 && !(ncol % 8)) datamatrix_corner(p, nrow, ncol, corner4, chr++);
+
+        // Sweep up and to the right
+        do {
+            if (row < nrow && col >= 0 && !p[row * ncol + col]) datamatrix_utah(p, nrow, ncol, row, col, chr++);
+            row -= 2;
+            col += 2;
+        } while (row >= 0 && col < ncol);
+        row += 1;
+        col += 3;
+
+        // Then down and to the left
+        do {
+            if (row >= 0 && col < ncol && !p[row * ncol + col]) datamatrix_utah(p, nrow, ncol, row, col, chr++);
+            row += 2;
+            col -= 2;
+        } while (row < nrow && col >= 0);
+        row += 3;
+        col += 1;
+    } while (row < nrow || col < ncol);
+
+    // Unused bottom-right corner gets a fixed pattern (1 = dark)
+    if (!p[nrow * ncol - 1]) {
+        p[nrow * ncol - 1] = p[(nrow - 1) * ncol - 2] = 1;
+    }
+}
+
+static bool datamatrix_encode(const int *values, int count, BarcodeSymbol *symbol) {
+    unsigned char codewords[DATAMATRIX_MAX_CODEWORDS];
+    int num_data = 0;
+
+    // ASCII encodation: digit pairs, FNC1 and upper shift for 128-255
+    for (int i = 0; i < count; i++) {
+        if (num_data + 2 > DATAMATRIX_SIZES[DATAMATRIX_NUM_SIZES - 1].data) {
+            fprintf(stderr, "Error: Barcode data is too long for a Data Matrix symbol.\n");
+            return false;
+        }
+        if (values[i] == FNC1) {
+            codewords[num_data++] = 232;
+        } else if (isdigit(values[i]) && i + 1 < count && values[i + 1] >= 0 && isdigit(values[i + 1])) {
+            codewords[num_data++] = (unsigned char)(130 + (values[i] - '0') * 10 + (values[i + 1] - '0'));
+            i++;
+        } else if (values[i] < 128) {
+            codewords[num_data++] = (unsigned char)(values[i] + 1);
+        } else {
+            codewords[num_data++] = 235;
+            codewords[num_data++] = (unsigned char)(values[i] - 127);
+        }
+    }
+
+    int s;
+    for (s = 0; s < DATAMATRIX_NUM_SIZES && DATAMATRIX_SIZES[s].data < num_data; s++);
+    if (s >= DATAMATRIX_NUM_SIZES) {
+        fprintf(stderr, "Error: Barcode data is too long for a Data Matrix symbol.\n");
+        return false;
+    }
+    const DataMatrixSize *dm = &DATAMATRIX_SIZES[s];
+
+    // First pad is 129, the rest are scrambled by position
+    for (int i = num_data; i < dm->data; i++) {
+        if (i == num_data) {
+            codewords[i] = 129;
+        } else {
+            int pad = 129 + ((149 * (i + 1)) % 253) + 1;
+            codewords[i] = (unsigned char)(pad > 254 ? pad - 254 : pad);
+        }
+    }
+
+    // Error correction per interleaved block, data codeword i belongs to block i % blocks
+    int block_ecc = dm->ecc / dm->blocks;
+    for (int b = 0; b < dm->blocks; b++) {
+        unsigned char block[DATAMATRIX_MAX_CODEWORDS], ecc[256];
+        int len = 0;
+        for (int i = b; i < dm->data; i += dm->blocks) {
+            block[len++] = codewords[i];
+        }
+        reed_solomon(block, len, ecc, block_ecc, GF_POLY_DATAMATRIX, 1);
+        for (int i = 0; i < block_ecc; i++) {
+            codewords[dm->data + i * dm->blocks + b] = ecc[i];
+        }
+    }
+
+    // Place codeword bits in the mapping matrix
+    int region = dm->size / dm->regions - 2;
+    int map_size = region * dm->regions;
+    int *placement = calloc((size_t)(map_size * map_size), sizeof(int));
+    unsigned char *modules = calloc((size_t)(dm->size * dm->size), 1);
+    if (!placement || !modules) {
+        fprintf(stderr, "Error: Out of memory encoding barcode.\n");
+        free(placement);
+        free(modules);
+        return false;
+    }
+    datamatrix_place(placement, map_size, map_size);
+
+    // Spread the mapping matrix over the data regions
+    for (int row = 0; row < map_size; row++) {
+        for (int col = 0; col < map_size; col++) {
+            int v = placement[row * map_size + col];
+            bool dark = v == 1 || (v >= 10 && (codewords[v / 10 - 1] >> (8 - v % 10)) & 1);
+            int y = row + 2 * (row / region) + 1;
+            int x = col + 2 * (col / region) + 1;
+            modules[y * dm->size + x] = dark;
+        }
+    }
+
+    // Each region has a solid L on the left and bottom, alternating top and right edges
+    for (int ry = 0; ry < dm->regions; ry++) {
+        for (int rx = 0; rx < dm->regions; rx++) {
+            int y0 = ry * (region + 2), x0 = rx * (region + 2);
+            for (int k = 0; k < region + 2; k++) {
+                modules[(y0 + region + 1) * dm->size + x0 + k] = 1;
+                modules[(y0 + k) * dm->size + x0] = 1;
+                modules[y0 * dm->size + x0 + k] |= (k % 2 == 0);
+                modules[(y0 + k) * dm->size + x0 + region + 1] |= (k % 2 == 1);
+            }
+        }
+    }
+
+    free(placement);
+    symbol->width = dm->size;
+    symbol->height = dm->size;
+    symbol->quiet_zone = DATAMATRIX_QUIET_ZONE;
+    symbol->modules = modules;
+    return true;
+}
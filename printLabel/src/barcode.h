@@ -0,0 +1,24 @@
+#ifndef BARCODE_H
+#define BARCODE_H
+
+#include <stdbool.h>
+#include "raster.h"
+
+typedef enum {
+    BARCODE_CODE128,
+    BARCODE_GS1_128,
+    BARCODE_QR,
+    BARCODE_DATAMATRIX,
+    BARCODE_GS1_DATAMATRIX
+} BarcodeType;
+
+// Looks up a symbology by name (code128, gs1-128, qr, datamatrix, gs1-datamatrix)
+bool barcode_parse_type(const char *name, BarcodeType *type);
+
+// Encodes data and draws it centered on the raster. GS1 data is given in
+// "(01)09501101530003(10)ABC" form. A module_dots of 0 picks the largest
+// whole number of dots per module that fits; every module is an exact
+// multiple of the dot grid. Errors are reported on stderr.
+bool barcode_draw(LabelRaster *raster, BarcodeType type, const char *data, int module_dots);
+
+#endif
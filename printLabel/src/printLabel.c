@@ -1,14 +1,42 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <unistd.h> // For sleep() and getopt
 #include <libcups3/cups/cups.h>
 #include <ctype.h>
 #include <stdbool.h>
 #include <math.h>
+#include <pthread.h>
+#include <zlib.h>
+#include "barcode.h"
+#include "preflight.h"
+
+#define LABEL_RESOLUTION 203 // Default dots per inch for printer-resolution and barcode rasters
+#define COMPRESS_CHUNK_SIZE 65536
+#define COMPRESS_QUEUE_DEPTH 4
+
+// Compressed chunks handed from the compressor thread to the sender
+typedef struct {
+    FILE           *fp;
+    bool            gzip;
+    unsigned char   chunks[COMPRESS_QUEUE_DEPTH][COMPRESS_CHUNK_SIZE];
+    size_t          lengths[COMPRESS_QUEUE_DEPTH];
+    size_t          produced;
+    size_t          consumed;
+    bool            done;
+    bool            failed;
+    bool            abort;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} CompressStream;
 
 char *base64Encoder(const char *data, size_t input_length);
+unsigned char *render_barcode_label(BarcodeType type, const char *data, int module_dots, int x_dimension, int y_dimension, int resolution, size_t *length);
+const char *select_compression(ipp_t *caps, const char *filetype);
+void *compress_thread(void *arg);
+ipp_t *send_compressed_document(http_t *http, ipp_t *request, const char *resource, FILE *fp, const char *compression);
 
 int main(int argc, char *argv[]) {
     const char *filename = NULL;
@@ -16,7 +44,14 @@ int main(int argc, char *argv[]) {
     const char *uri_hostname = NULL;
     const char *username = NULL;
     const char *password = NULL;
+    const char *barcode = NULL;
+    BarcodeType barcode_type = BARCODE_CODE128;
+    const char *barcode_data = NULL;
+    int module_dots = 0;
     bool use_auth = false;
+    bool use_compression = true;
+    bool strict = false; // Fail preflight instead of adjusting to the nearest supported value
+    const char *compression = NULL;
     int port = 631; // Default port
     http_t *http = NULL;
     ipp_t *request = NULL, *response = NULL;
@@ -28,12 +63,17 @@ int main(int argc, char *argv[]) {
     int x_dimension = 10160;  // Default 4x1
     int y_dimension = 2540;   // Default 4x1
 	const char *media_tracking = "mark";
+    int darkness = 100;
+    int speed = 500;
+    int resolution = LABEL_RESOLUTION;
+    unsigned char *document = NULL;  // In-memory document when printing a barcode
+    size_t document_length = 0;
 
     int opt;
     opterr = 0; // Disable getopt's default error printing
 
     // MODIFIED: Added -x and -y options to getopt
-    while ((opt = getopt(argc, argv, "h:p:f:m:U:P:ax:y:t:")) != -1) {
+    while ((opt = getopt(argc, argv, "h:p:f:m:U:P:ax:y:t:b:w:zS")) != -1) {
         switch (opt) {
             case 'h':
                 uri_hostname = optarg;
@@ -56,6 +96,12 @@ int main(int argc, char *argv[]) {
             case 'a':
                 use_auth = true;
                 break;
+            case 'z':
+                use_compression = false;
+                break;
+            case 'S':
+                strict = true;
+                break;
             // ADDED: Cases for -x and -y
             case 'x':
                 x_dimension = atoi(optarg);
@@ -66,12 +112,18 @@ int main(int argc, char *argv[]) {
 			case 't':
                 media_tracking = optarg;
                 break;
+            case 'b':
+                barcode = optarg;
+                break;
+            case 'w':
+                module_dots = atoi(optarg);
+                break;
 
             case '?':
                 if (optopt == 'h' || optopt == 'p' || optopt == 'f' || optopt == 'm' || optopt == 'U' || optopt == 'P')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 // ADDED:  Error handling for -x and -y
-                else if (optopt == 'x' || optopt == 'y' || optopt == 't')
+                else if (optopt == 'x' || optopt == 'y' || optopt == 't' || optopt == 'b' || optopt == 'w')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 else if (isprint(optopt))
                     fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -83,16 +135,29 @@ int main(int argc, char *argv[]) {
         }
     }
 
-      if (uri_hostname == NULL || filename == NULL || filetype == NULL) {
+    // A generated barcode label is always PWG raster
+    if (barcode != NULL && filetype != NULL && strcmp(filetype, "image/pwg-raster") != 0) {
+        fprintf(stderr, "Error: Barcode labels (-b) are sent as image/pwg-raster; -m %s doesn't apply.\n", filetype);
+        return 1;
+    }
+    if (barcode != NULL)
+        filetype = "image/pwg-raster";
+
+      if (uri_hostname == NULL || (filename == NULL) == (barcode == NULL) || filetype == NULL) {
         // MODIFIED: Updated usage message
-        fprintf(stderr, "Usage: %s -h <hostname> [-p <port>] -f <filename> -m <mime_type> [-x <xdim>] [-y <ydim>] [-t <tracking>] [-u <username> -P <password> -a]\n", argv[0]);
+        fprintf(stderr, "Usage: %s -h <hostname> [-p <port>] (-f <filename> -m <mime_type> | -b <type>:<data> [-w <dots>]) [-x <xdim>] [-y <ydim>] [-t <tracking>] [-z] [-S] [-u <username> -P <password> -a]\n", argv[0]);
         fprintf(stderr, "  -h <hostname>:  Hostname or IP address of the printer (required).\n");
         fprintf(stderr, "  -p <port>:      Port number for the printer (optional, default is 631).\n");
-        fprintf(stderr, "  -f <filename>:  Path to the file to print (required).\n");
-        fprintf(stderr, "  -m <mime_type>: MIME type of the file (e.g., image/jpeg, application/pdf) (required).\n");
+        fprintf(stderr, "  -f <filename>:  Path to the file to print (required unless -b is used).\n");
+        fprintf(stderr, "  -m <mime_type>: MIME type of the file (e.g., image/jpeg, application/pdf) (required with -f).\n");
+        fprintf(stderr, "  -b <type>:<data>: Print a barcode label instead of a file; type is code128, gs1-128, qr,\n");
+        fprintf(stderr, "                  datamatrix or gs1-datamatrix, GS1 data is written as (01)09501101530003(10)ABC.\n");
+        fprintf(stderr, "  -w <dots>:      Barcode module width in %d dpi dots (optional, default is the largest that fits).\n", LABEL_RESOLUTION);
         fprintf(stderr, "  -x <xdim>:      X dimension of the media in 1/1000 inch (optional, default is 10160).\n");
         fprintf(stderr, "  -y <ydim>:      Y dimension of the media in 1/1000 inch (optional, default is 2540).\n");
 		fprintf(stderr, "  -t <tracking>:  Media Tracking (mark, continuous, gap) (optional, default is mark).\n");
+        fprintf(stderr, "  -z:             Don't compress the document even if the printer supports it (optional).\n");
+        fprintf(stderr, "  -S:             Strict preflight: fail instead of using the nearest supported media, speed, etc. (optional).\n");
         fprintf(stderr, "  -U <username>:  Username for authentication (optional).\n");
         fprintf(stderr, "  -P <password>:  Password for authentication (optional).\n");
         fprintf(stderr, "  -a:             Enable authentication (use with -U and -P).\n");
@@ -105,6 +170,27 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // Render the barcode label before connecting so bad data fails fast
+    if (barcode != NULL) {
+        char type_name[32];
+        barcode_data = strchr(barcode, ':');
+
+        if (barcode_data == NULL || (size_t)(barcode_data - barcode) >= sizeof(type_name)) {
+            fprintf(stderr, "Error: Barcode must be given as <type>:<data>.\n");
+            return 1;
+        }
+        snprintf(type_name, sizeof(type_name), "%.*s", (int)(barcode_data - barcode), barcode);
+        barcode_data++;
+
+        if (!barcode_parse_type(type_name, &barcode_type)) {
+            fprintf(stderr, "Error: Unknown barcode type \"%s\".\n", type_name);
+            return 1;
+        }
+
+        document = render_barcode_label(barcode_type, barcode_data, module_dots, x_dimension, y_dimension, resolution, &document_length);
+        if (document == NULL)
+            return 1;
+    }
 
     // Establish a connection to the printer
      http = httpConnect(uri_hostname, port, NULL, AF_UNSPEC, HTTP_ENCRYPTION_ALWAYS, 1, 30000, NULL);
@@ -130,11 +216,50 @@ int main(int argc, char *argv[]) {
         free(auth_string);
     }
 
+    // Preflight the job against the printer capabilities (cached locally) before sending any document data
+    ipp_t *caps = preflight_get_capabilities(http, printer_uri_str, uri_hostname, port, PREFLIGHT_CACHE_MAX_AGE);
+    if (caps != NULL) {
+        PreflightJob job = {filetype, x_dimension, y_dimension, media_tracking, darkness, speed, resolution};
+        if (!preflight_check(caps, &job, strict)) {
+            fprintf(stderr, "Error: Job failed preflight, nothing was sent.\n");
+            ippDelete(caps);
+            free(document);
+            httpClose(http);
+            return 1;
+        }
+
+        // A barcode label has to be redrawn for a different media size or resolution
+        if (document != NULL && (job.x_dimension != x_dimension || job.y_dimension != y_dimension || job.resolution != resolution)) {
+            free(document);
+            document = render_barcode_label(barcode_type, barcode_data, module_dots, job.x_dimension, job.y_dimension, job.resolution, &document_length);
+            if (document == NULL) {
+                ippDelete(caps);
+                httpClose(http);
+                return 1;
+            }
+        }
+
+        x_dimension = job.x_dimension;
+        y_dimension = job.y_dimension;
+        media_tracking = job.media_tracking;
+        darkness = job.darkness;
+        speed = job.speed;
+        resolution = job.resolution;
+    } else {
+        fprintf(stderr, "Warning: Printer capabilities unavailable, skipping preflight.\n");
+    }
+
+    // Compress the document on the way out if the printer accepts gzip or deflate
+    if (use_compression && caps != NULL)
+        compression = select_compression(caps, filetype);
+
     // Create a new IPP request
     request = ippNewRequest(IPP_OP_PRINT_JOB);
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri_str);			// Printer URI (already constructed)
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());	// Requesting User Name
     ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE, "document-format", NULL, filetype); 			// Document Format (MIME Type)
+    if (compression != NULL)
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "compression", NULL, compression);		// Document Compression
 
     // --- Constructing media-col collection - media-size ---
     ipp_t *media_col = ippNew();
@@ -160,13 +285,37 @@ int main(int argc, char *argv[]) {
     ippDelete(media_col);
     // --- media-col construction complete ---
 
-    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-darkness", 100);						// print darkness
-    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-speed", 500);							// print speed
+    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-darkness", darkness);					// print darkness
+    ippAddInteger(request, IPP_TAG_JOB, IPP_TAG_INTEGER, "print-speed", speed);						// print speed
     ippAddString(request, IPP_TAG_JOB, IPP_TAG_KEYWORD, "print-color-mode", NULL, "monochrome"); 		// Request Monochrome Printing:
-    ippAddResolution(request, IPP_TAG_JOB, "printer-resolution", IPP_RES_PER_INCH, 203, 203);
+    ippAddResolution(request, IPP_TAG_JOB, "printer-resolution", IPP_RES_PER_INCH, resolution, resolution);
+    ippDelete(caps); // media_tracking may point into caps until it has been added
 
     // Send the request and receive the response
-    response = cupsDoFileRequest(http, request, "/ipp/print", filename);
+    if (compression != NULL) {
+        FILE *fp = document != NULL ? fmemopen(document, document_length, "rb") : fopen(filename, "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "Error: Unable to open document.\n");
+            free(document);
+            httpClose(http);
+            ippDelete(request);
+            return 1;
+        }
+        response = send_compressed_document(http, request, "/ipp/print", fp, compression);
+        fclose(fp);
+        free(document);
+    } else if (document != NULL) {
+        http_status_t http_status = cupsSendRequest(http, request, "/ipp/print", CUPS_LENGTH_VARIABLE);
+        if (http_status == HTTP_STATUS_CONTINUE)
+            http_status = cupsWriteRequestData(http, (const char *)document, document_length);
+        if (http_status == HTTP_STATUS_CONTINUE)
+            response = cupsGetResponse(http, "/ipp/print");
+        else
+            httpFlush(http);
+        free(document);
+    } else {
+        response = cupsDoFileRequest(http, request, "/ipp/print", filename);
+    }
 
     if (response == NULL) {
         fprintf(stderr, "Error sending print request: %s\n", cupsGetErrorString());
@@ -179,6 +328,9 @@ int main(int argc, char *argv[]) {
 
     if (status > IPP_STATUS_OK) {
         fprintf(stderr, "Print job submission failed: %s\n", cupsGetErrorString());
+        // The cached capabilities let a bad job through, so fetch them again next time
+        if (status == IPP_STATUS_ERROR_ATTRIBUTES_OR_VALUES || status == IPP_STATUS_ERROR_DOCUMENT_FORMAT_NOT_SUPPORTED)
+            preflight_invalidate(uri_hostname, port);
         ippDelete(response);
         ippDelete(request);
         httpClose(http);
@@ -197,6 +349,188 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
+// --- Function to draw a barcode label and encode it as PWG raster, NULL on error ---
+unsigned char *render_barcode_label(BarcodeType type, const char *data, int module_dots, int x_dimension, int y_dimension, int resolution, size_t *length) {
+    // media-size is in hundredths of millimeters
+    LabelRaster raster;
+    if (!raster_init(&raster, x_dimension * resolution / 2540, y_dimension * resolution / 2540)) {
+        fprintf(stderr, "Error: Unable to allocate a %dx%d label raster.\n", x_dimension, y_dimension);
+        return NULL;
+    }
+    if (!barcode_draw(&raster, type, data, module_dots)) {
+        raster_free(&raster);
+        return NULL;
+    }
+
+    unsigned char *document = raster_write_pwg(&raster, resolution, length);
+    raster_free(&raster);
+    if (document == NULL)
+        fprintf(stderr, "Error: Unable to encode barcode label.\n");
+
+    return document;
+}
+
+// --- Function to pick a document compression the printer supports, NULL for none (from print-mon.c) ---
+const char *select_compression(ipp_t *caps, const char *filetype) {
+    // Already-compressed formats don't shrink enough to be worth the CPU
+    static const char * const precompressed[] = {
+        "image/jpeg", "image/png", "image/gif", "image/jp2", "image/tiff",
+        "application/gzip", "application/zip", "application/x-gzip"
+    };
+    for (size_t i = 0; i < sizeof(precompressed) / sizeof(precompressed[0]); i++) {
+        if (!strcasecmp(filetype, precompressed[i])) {
+            return NULL;
+        }
+    }
+
+    ipp_attribute_t *attr = ippFindAttribute(caps, "compression-supported", IPP_TAG_KEYWORD);
+    if (attr && ippContainsString(attr, "gzip")) {
+        return "gzip";
+    } else if (attr && ippContainsString(attr, "deflate")) {
+        return "deflate";
+    }
+
+    return NULL;
+}
+
+// --- Compressor thread: deflates the document into the chunk queue (from print-mon.c) ---
+void *compress_thread(void *arg) {
+    CompressStream *cs = (CompressStream *)arg;
+    unsigned char input[COMPRESS_CHUNK_SIZE];
+    z_stream zs;
+    int flush, ret = Z_OK;
+    size_t slot;
+
+    memset(&zs, 0, sizeof(zs));
+    // gzip is RFC 1952 (windowBits + 16); IPP "deflate" is raw RFC 1951 (negative windowBits)
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, cs->gzip ? 15 + 16 : -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        pthread_mutex_lock(&cs->lock);
+        cs->failed = cs->done = true;
+        pthread_cond_broadcast(&cs->cond);
+        pthread_mutex_unlock(&cs->lock);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cs->lock);
+    slot = cs->produced % COMPRESS_QUEUE_DEPTH;
+    pthread_mutex_unlock(&cs->lock);
+    zs.next_out = cs->chunks[slot];
+    zs.avail_out = COMPRESS_CHUNK_SIZE;
+
+    do {
+        zs.avail_in = (uInt)fread(input, 1, sizeof(input), cs->fp);
+        if (ferror(cs->fp)) {
+            ret = Z_ERRNO;
+            break;
+        }
+        flush = feof(cs->fp) ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = input;
+
+        do {
+            ret = deflate(&zs, flush);
+
+            // Hand off each full chunk, waiting while the sender is a full queue behind
+            if (zs.avail_out == 0) {
+                pthread_mutex_lock(&cs->lock);
+                cs->lengths[slot] = COMPRESS_CHUNK_SIZE;
+                cs->produced++;
+                pthread_cond_broadcast(&cs->cond);
+                while (!cs->abort && cs->produced - cs->consumed >= COMPRESS_QUEUE_DEPTH) {
+                    pthread_cond_wait(&cs->cond, &cs->lock);
+                }
+                bool abort = cs->abort;
+                slot = cs->produced % COMPRESS_QUEUE_DEPTH;
+                pthread_mutex_unlock(&cs->lock);
+
+                if (abort) {
+                    deflateEnd(&zs);
+                    return NULL;
+                }
+                zs.next_out = cs->chunks[slot];
+                zs.avail_out = COMPRESS_CHUNK_SIZE;
+            }
+        } while (ret != Z_STREAM_ERROR && (zs.avail_in > 0 || (flush == Z_FINISH && ret != Z_STREAM_END)));
+    } while (ret != Z_STREAM_ERROR && flush != Z_FINISH);
+
+    pthread_mutex_lock(&cs->lock);
+    if (ret == Z_STREAM_END && zs.avail_out < COMPRESS_CHUNK_SIZE) {
+        cs->lengths[slot] = COMPRESS_CHUNK_SIZE - zs.avail_out;
+        cs->produced++;
+    }
+    cs->failed = ret != Z_STREAM_END;
+    cs->done = true;
+    pthread_cond_broadcast(&cs->cond);
+    pthread_mutex_unlock(&cs->lock);
+
+    deflateEnd(&zs);
+    return NULL;
+}
+
+// --- Function to send a print request with the document compressed on the fly (from print-mon.c) ---
+ipp_t *send_compressed_document(http_t *http, ipp_t *request, const char *resource, FILE *fp, const char *compression) {
+    CompressStream *cs = calloc(1, sizeof(CompressStream));
+    if (!cs) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        return NULL;
+    }
+    cs->fp = fp;
+    cs->gzip = !strcmp(compression, "gzip");
+    pthread_mutex_init(&cs->lock, NULL);
+    pthread_cond_init(&cs->cond, NULL);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, compress_thread, cs) != 0) {
+        fprintf(stderr, "Error: Unable to start compressor thread.\n");
+        pthread_cond_destroy(&cs->cond);
+        pthread_mutex_destroy(&cs->lock);
+        free(cs);
+        return NULL;
+    }
+
+    // Length isn't known up front, so the request body is chunked
+    http_status_t status = cupsSendRequest(http, request, resource, CUPS_LENGTH_VARIABLE);
+
+    // Send chunks as they are compressed; the compressor keeps working during each write
+    pthread_mutex_lock(&cs->lock);
+    while (status == HTTP_STATUS_CONTINUE) {
+        while (cs->consumed == cs->produced && !cs->done) {
+            pthread_cond_wait(&cs->cond, &cs->lock);
+        }
+        if (cs->consumed == cs->produced) {
+            break;
+        }
+
+        size_t slot = cs->consumed % COMPRESS_QUEUE_DEPTH;
+        pthread_mutex_unlock(&cs->lock);
+        status = cupsWriteRequestData(http, (const char *)cs->chunks[slot], cs->lengths[slot]);
+        pthread_mutex_lock(&cs->lock);
+
+        cs->consumed++;
+        pthread_cond_broadcast(&cs->cond);
+    }
+    bool failed = cs->failed;
+    cs->abort = true;
+    pthread_cond_broadcast(&cs->cond);
+    pthread_mutex_unlock(&cs->lock);
+    pthread_join(thread, NULL);
+
+    ipp_t *response = NULL;
+    if (failed) {
+        fprintf(stderr, "Error: Unable to compress document.\n");
+        httpFlush(http);
+    } else if (status == HTTP_STATUS_CONTINUE) {
+        response = cupsGetResponse(http, resource);
+    } else {
+        httpFlush(http);
+    }
+
+    pthread_cond_destroy(&cs->cond);
+    pthread_mutex_destroy(&cs->lock);
+    free(cs);
+
+    return response;
+}
+
 // Function to encode a string to Base64 (Simplified version for demonstration)
 char *base64Encoder(const char *data, size_t input_length) {
     const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
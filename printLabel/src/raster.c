@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "raster.h"
+
+// --- PWG 5102.4 page header layout ---
+#define PWG_SYNC_WORD "RaS2"
+#define PWG_HEADER_SIZE 1796
+#define PWG_MEDIA_CLASS 0
+#define PWG_MEDIA_TYPE 128
+#define PWG_HW_RESOLUTION 276
+#define PWG_NUM_COPIES 340
+#define PWG_PAGE_SIZE 352
+#define PWG_WIDTH 372
+#define PWG_HEIGHT 376
+#define PWG_BITS_PER_COLOR 384
+#define PWG_BITS_PER_PIXEL 388
+#define PWG_BYTES_PER_LINE 392
+#define PWG_COLOR_ORDER 396
+#define PWG_COLOR_SPACE 400
+#define PWG_NUM_COLORS 420
+#define PWG_TOTAL_PAGE_COUNT 452
+#define PWG_CROSS_FEED_TRANSFORM 456
+#define PWG_FEED_TRANSFORM 460
+#define PWG_PAGE_SIZE_NAME 1732
+#define PWG_CSPACE_BLACK 3
+
+static void put_be32(unsigned char *ptr, uint32_t value);
+static size_t compress_line(const unsigned char *line, size_t length, unsigned char *out);
+
+// --- Function to allocate a blank (white) bitmap ---
+bool raster_init(LabelRaster *raster, int width, int height) {
+    memset(raster, 0, sizeof(*raster));
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    raster->width = width;
+    raster->height = height;
+    raster->bytes_per_line = ((size_t)width + 7) / 8;
+    raster->bits = calloc((size_t)height, raster->bytes_per_line);
+
+    return raster->bits != NULL;
+}
+
+// --- Function to free a bitmap ---
+void raster_free(LabelRaster *raster) {
+    free(raster->bits);
+    memset(raster, 0, sizeof(*raster));
+}
+
+// --- Function to blacken a rectangle, clipped to the bitmap ---
+void raster_fill(LabelRaster *raster, int x, int y, int width, int height) {
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > raster->width) width = raster->width - x;
+    if (y + height > raster->height) height = raster->height - y;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    // Partial bytes at either end, whole bytes in between
+    int x2 = x + width;
+    size_t first = (size_t)x / 8, last = (size_t)(x2 - 1) / 8;
+    unsigned char first_mask = (unsigned char)(0xff >> (x % 8));
+    unsigned char last_mask = (unsigned char)(0xff << (7 - (x2 - 1) % 8));
+
+    for (int row = y; row < y + height; row++) {
+        unsigned char *line = raster->bits + (size_t)row * raster->bytes_per_line;
+        if (first == last) {
+            line[first] |= first_mask & last_mask;
+        } else {
+            line[first] |= first_mask;
+            memset(line + first + 1, 0xff, last - first - 1);
+            line[last] |= last_mask;
+        }
+    }
+}
+
+// --- Function to encode the bitmap as PWG raster ---
+unsigned char *raster_write_pwg(const LabelRaster *raster, int resolution, size_t *length) {
+    size_t bpl = raster->bytes_per_line;
+    // Worst case per line: repeat byte, plus a count byte for every data byte
+    size_t max_line = 1 + 2 * bpl;
+    unsigned char *buffer = malloc(4 + PWG_HEADER_SIZE + max_line * (size_t)raster->height);
+    if (!buffer) {
+        return NULL;
+    }
+
+    memcpy(buffer, PWG_SYNC_WORD, 4);
+
+    unsigned char *header = buffer + 4;
+    memset(header, 0, PWG_HEADER_SIZE);
+    strcpy((char *)header + PWG_MEDIA_CLASS, "PwgRaster");
+    strcpy((char *)header + PWG_MEDIA_TYPE, "labels-continuous");
+    put_be32(header + PWG_HW_RESOLUTION, (uint32_t)resolution);
+    put_be32(header + PWG_HW_RESOLUTION + 4, (uint32_t)resolution);
+    put_be32(header + PWG_NUM_COPIES, 1);
+    put_be32(header + PWG_PAGE_SIZE, (uint32_t)(raster->width * 72 / resolution));
+    put_be32(header + PWG_PAGE_SIZE + 4, (uint32_t)(raster->height * 72 / resolution));
+    put_be32(header + PWG_WIDTH, (uint32_t)raster->width);
+    put_be32(header + PWG_HEIGHT, (uint32_t)raster->height);
+    put_be32(header + PWG_BITS_PER_COLOR, 1);
+    put_be32(header + PWG_BITS_PER_PIXEL, 1);
+    put_be32(header + PWG_BYTES_PER_LINE, (uint32_t)bpl);
+    put_be32(header + PWG_COLOR_ORDER, 0);
+    put_be32(header + PWG_COLOR_SPACE, PWG_CSPACE_BLACK);
+    put_be32(header + PWG_NUM_COLORS, 1);
+    put_be32(header + PWG_TOTAL_PAGE_COUNT, 1);
+    put_be32(header + PWG_CROSS_FEED_TRANSFORM, 1);
+    put_be32(header + PWG_FEED_TRANSFORM, 1);
+    snprintf((char *)header + PWG_PAGE_SIZE_NAME, 64, "custom_%.2fx%.2fin_%.2fx%.2fin",
+             (double)raster->width / resolution, (double)raster->height / resolution,
+             (double)raster->width / resolution, (double)raster->height / resolution);
+
+    // Each line is a repeat count for identical following lines plus PackBits-style data
+    unsigned char *out = header + PWG_HEADER_SIZE;
+    for (int row = 0; row < raster->height;) {
+        const unsigned char *line = raster->bits + (size_t)row * bpl;
+        int repeat = 1;
+        while (row + repeat < raster->height && repeat < 256 &&
+               !memcmp(line, line + (size_t)repeat * bpl, bpl)) {
+            repeat++;
+        }
+
+        *out++ = (unsigned char)(repeat - 1);
+        out += compress_line(line, bpl, out);
+        row += repeat;
+    }
+
+    *length = (size_t)(out - buffer);
+    return buffer;
+}
+
+// --- Helper to store a big-endian 32-bit header value ---
+static void put_be32(unsigned char *ptr, uint32_t value) {
+    ptr[0] = (unsigned char)(value >> 24);
+    ptr[1] = (unsigned char)(value >> 16);
+    ptr[2] = (unsigned char)(value >> 8);
+    ptr[3] = (unsigned char)value;
+}
+
+// --- Helper to compress one line: 0-127 repeats the next byte n+1 times, 129-255 copies 257-n bytes ---
+static size_t compress_line(const unsigned char *line, size_t length, unsigned char *out) {
+    unsigned char *start = out;
+    size_t i = 0;
+
+    while (i < length) {
+        size_t run = 1;
+        while (i + run < length && run < 128 && line[i + run] == line[i]) {
+            run++;
+        }
+
+        if (run > 1 || i + 1 == length) {
+            *out++ = (unsigned char)(run - 1);
+            *out++ = line[i];
+            i += run;
+        } else {
+            // Literal bytes up to the next pair of repeated bytes
+            size_t count = 1;
+            while (i + count < length && count < 128 &&
+                   (i + count + 1 >= length || line[i + count] != line[i + count + 1])) {
+                count++;
+            }
+            if (count == 1) {
+                *out++ = 0;
+                *out++ = line[i];
+            } else {
+                *out++ = (unsigned char)(257 - count);
+                memcpy(out, line + i, count);
+                out += count;
+            }
+            i += count;
+        }
+    }
+
+    return (size_t)(out - start);
+}
@@ -0,0 +1,22 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// --- 1-bit label bitmap: rows are MSB first, a set bit is a black dot ---
+typedef struct {
+    int            width;           // Dots
+    int            height;          // Dots
+    size_t         bytes_per_line;
+    unsigned char *bits;
+} LabelRaster;
+
+bool raster_init(LabelRaster *raster, int width, int height);
+void raster_free(LabelRaster *raster);
+void raster_fill(LabelRaster *raster, int x, int y, int width, int height);
+
+// Encodes the bitmap as a single-page image/pwg-raster document (black_1)
+unsigned char *raster_write_pwg(const LabelRaster *raster, int resolution, size_t *length);
+
+#endif
@@ -0,0 +1,280 @@
+#include <string.h>
+#include "ipp-stream.h"
+
+#define IPP_STREAM_READ_SIZE 4096
+
+// Parser states
+enum {
+    STREAM_HEADER,          // version-number, status-code, request-id
+    STREAM_TAG,             // delimiter or value tag
+    STREAM_NAME_LENGTH,
+    STREAM_NAME,
+    STREAM_VALUE_LENGTH,
+    STREAM_VALUE,
+    STREAM_DONE             // end-of-attributes-tag seen
+};
+
+static bool take_fixed(IppStreamResponse *resp, const unsigned char **data, const unsigned char *end, size_t size);
+static void start_attribute(IppStreamResponse *resp);
+static void finish_value(IppStreamResponse *resp);
+static void store_value(IppStreamAttr *attr, ipp_tag_t tag, const unsigned char *value, size_t length);
+
+// --- Function to set up a response for parsing ---
+void ipp_stream_init(IppStreamResponse *resp, const char * const *names, int num_names) {
+    // Only the bookkeeping is reset; value buffers are always written before they are read
+    resp->status = IPP_STATUS_ERROR_INTERNAL;
+    resp->request_id = 0;
+    resp->http_status = HTTP_STATUS_NONE;
+    resp->num_attrs = num_names < IPP_STREAM_MAX_ATTRS ? num_names : IPP_STREAM_MAX_ATTRS;
+    for (int i = 0; i < resp->num_attrs; i++) {
+        resp->attrs[i].name = names[i];
+        resp->attrs[i].value_tag = IPP_TAG_ZERO;
+        resp->attrs[i].num_values = 0;
+    }
+
+    resp->state = STREAM_HEADER;
+    resp->have = 0;
+    resp->current = NULL;
+    resp->depth = 0;
+}
+
+// --- Function to parse the next chunk of a response ---
+bool ipp_stream_feed(IppStreamResponse *resp, const unsigned char *data, size_t length) {
+    const unsigned char *end = data + length;
+
+    while (data < end && resp->state != STREAM_DONE) {
+        switch (resp->state) {
+            case STREAM_HEADER:
+                if (take_fixed(resp, &data, end, 8)) {
+                    resp->status = (ipp_status_t)((resp->scratch[2] << 8) | resp->scratch[3]);
+                    resp->request_id = (int)(((unsigned)resp->scratch[4] << 24) | ((unsigned)resp->scratch[5] << 16) |
+                                             ((unsigned)resp->scratch[6] << 8) | resp->scratch[7]);
+                    resp->state = STREAM_TAG;
+                }
+                break;
+
+            case STREAM_TAG:
+                resp->tag = (ipp_tag_t)*data++;
+                if (resp->tag == IPP_TAG_END) {
+                    resp->state = STREAM_DONE;
+                } else if (resp->tag < IPP_TAG_UNSUPPORTED_VALUE) {
+                    resp->current = NULL;               // New group, values can't continue across it
+                } else {
+                    resp->state = STREAM_NAME_LENGTH;
+                }
+                break;
+
+            case STREAM_NAME_LENGTH:
+                if (take_fixed(resp, &data, end, 2)) {
+                    resp->value_length = ((size_t)resp->scratch[0] << 8) | resp->scratch[1];
+                    resp->value_have = 0;
+                    resp->name_length = 0;
+                    if (resp->value_length > 0) {
+                        resp->state = STREAM_NAME;
+                    } else {
+                        resp->state = STREAM_VALUE_LENGTH; // Another value of the current attribute
+                    }
+                }
+                break;
+
+            case STREAM_NAME: {
+                size_t count = resp->value_length - resp->value_have;
+                if (count > (size_t)(end - data)) {
+                    count = (size_t)(end - data);
+                }
+                // Names too long to have been requested are skipped, not stored
+                if (resp->name_length + count <= sizeof(resp->name)) {
+                    memcpy(resp->name + resp->name_length, data, count);
+                }
+                resp->name_length += count;
+                resp->value_have += count;
+                data += count;
+                if (resp->value_have == resp->value_length) {
+                    start_attribute(resp);
+                    resp->state = STREAM_VALUE_LENGTH;
+                }
+                break;
+            }
+
+            case STREAM_VALUE_LENGTH:
+                if (take_fixed(resp, &data, end, 2)) {
+                    resp->value_length = ((size_t)resp->scratch[0] << 8) | resp->scratch[1];
+                    resp->value_have = 0;
+                    if (resp->value_length > 0) {
+                        resp->state = STREAM_VALUE;
+                    } else {
+                        finish_value(resp);
+                    }
+                }
+                break;
+
+            case STREAM_VALUE: {
+                size_t count = resp->value_length - resp->value_have;
+                if (count > (size_t)(end - data)) {
+                    count = (size_t)(end - data);
+                }
+                // Only values of a requested attribute are copied, and only as much as fits
+                if (resp->current && resp->depth == 0 && resp->value_have < sizeof(resp->value)) {
+                    size_t keep = sizeof(resp->value) - resp->value_have;
+                    memcpy(resp->value + resp->value_have, data, count < keep ? count : keep);
+                }
+                resp->value_have += count;
+                data += count;
+                if (resp->value_have == resp->value_length) {
+                    finish_value(resp);
+                }
+                break;
+            }
+        }
+    }
+
+    return resp->state == STREAM_DONE;
+}
+
+// --- Function to send a request and parse the response off the connection ---
+bool ipp_stream_do_request(http_t *http, ipp_t *request, const char *resource, IppStreamResponse *resp) {
+    unsigned char buffer[IPP_STREAM_READ_SIZE];
+    bool done = false;
+    ssize_t bytes;
+
+    resp->http_status = cupsSendRequest(http, request, resource, 0);
+    if (resp->http_status == HTTP_STATUS_CONTINUE) {
+        while ((resp->http_status = httpUpdate(http)) == HTTP_STATUS_CONTINUE);
+    }
+    if (resp->http_status != HTTP_STATUS_OK) {
+        httpFlush(http);
+        return false;
+    }
+
+    // Read to the end of the body even once the attributes are done, so the connection can be reused
+    while ((bytes = httpRead(http, (char *)buffer, sizeof(buffer))) > 0) {
+        if (!done) {
+            done = ipp_stream_feed(resp, buffer, (size_t)bytes);
+        }
+    }
+
+    return done;
+}
+
+// --- Function to look up a requested attribute ---
+const IppStreamAttr *ipp_stream_find(const IppStreamResponse *resp, const char *name) {
+    for (int i = 0; i < resp->num_attrs; i++) {
+        if (resp->attrs[i].value_tag != IPP_TAG_ZERO && !strcmp(resp->attrs[i].name, name)) {
+            return &resp->attrs[i];
+        }
+    }
+    return NULL;
+}
+
+// --- Function to describe a failed or unsuccessful request ---
+const char *ipp_stream_error_string(const IppStreamResponse *resp) {
+    if (resp->http_status == HTTP_STATUS_ERROR || resp->http_status == HTTP_STATUS_NONE) {
+        return cupsGetErrorString();
+    } else if (resp->http_status != HTTP_STATUS_OK) {
+        return httpStatusString(resp->http_status);
+    } else if (resp->state != STREAM_DONE) {
+        return "Truncated IPP response";
+    }
+    return ippErrorString(resp->status);
+}
+
+// --- Helper to gather a fixed-size field that may be split across chunks ---
+static bool take_fixed(IppStreamResponse *resp, const unsigned char **data, const unsigned char *end, size_t size) {
+    size_t count = size - resp->have;
+    if (count > (size_t)(end - *data)) {
+        count = (size_t)(end - *data);
+    }
+    memcpy(resp->scratch + resp->have, *data, count);
+    *data += count;
+    resp->have += count;
+    if (resp->have < size) {
+        return false;
+    }
+    resp->have = 0;
+    return true;
+}
+
+// --- Helper to match a completed attribute name against the requested ones ---
+static void start_attribute(IppStreamResponse *resp) {
+    resp->current = NULL;
+    if (resp->depth > 0 || resp->name_length > sizeof(resp->name)) {
+        return;
+    }
+
+    for (int i = 0; i < resp->num_attrs; i++) {
+        IppStreamAttr *attr = &resp->attrs[i];
+        if (!strncmp(attr->name, resp->name, resp->name_length) && attr->name[resp->name_length] == '\0') {
+            // A later occurrence (e.g. in the next job group) doesn't overwrite the first
+            if (attr->value_tag == IPP_TAG_ZERO) {
+                resp->current = attr;
+            }
+            return;
+        }
+    }
+}
+
+// --- Helper to act on a completed value ---
+static void finish_value(IppStreamResponse *resp) {
+    if (resp->tag == IPP_TAG_END_COLLECTION) {
+        if (resp->depth > 0) {
+            resp->depth--;
+        }
+    } else if (resp->current && resp->depth == 0) {
+        size_t kept = resp->value_length < sizeof(resp->value) ? resp->value_length : sizeof(resp->value);
+        store_value(resp->current, resp->tag, resp->value, kept);
+    }
+
+    // A collection counts as one value of its attribute; its members are skipped
+    if (resp->tag == IPP_TAG_BEGIN_COLLECTION) {
+        resp->depth++;
+    }
+
+    resp->state = STREAM_TAG;
+}
+
+// --- Helper to decode one value into the attribute's fixed slots ---
+static void store_value(IppStreamAttr *attr, ipp_tag_t tag, const unsigned char *value, size_t length) {
+    if (attr->value_tag == IPP_TAG_ZERO) {
+        attr->value_tag = tag;
+    }
+    int i = attr->num_values++;
+    if (i >= IPP_STREAM_MAX_VALUES) {
+        return;
+    }
+
+    if (length >= 4) {
+        attr->integers[i] = (int)(((unsigned)value[0] << 24) | ((unsigned)value[1] << 16) | ((unsigned)value[2] << 8) | value[3]);
+    } else {
+        attr->integers[i] = length == 1 ? value[0] : 0;
+    }
+
+    // integer, boolean and enum values have no string form
+    if (tag < IPP_TAG_STRING) {
+        attr->strings[i][0] = '\0';
+        attr->lengths[i] = 0;
+        return;
+    }
+
+    // textWithLanguage and nameWithLanguage: language length, language, text length, text
+    const unsigned char *text = value;
+    size_t text_length = length;
+    if (tag == IPP_TAG_TEXTLANG || tag == IPP_TAG_NAMELANG) {
+        size_t language_length = length >= 2 ? ((size_t)value[0] << 8) | value[1] : length;
+        if (language_length + 4 <= length) {
+            text = value + language_length + 4;
+            text_length = ((size_t)value[language_length + 2] << 8) | value[language_length + 3];
+            if (text_length > length - language_length - 4) {
+                text_length = length - language_length - 4;
+            }
+        } else {
+            text_length = 0;
+        }
+    }
+
+    if (text_length >= IPP_STREAM_VALUE_MAX) {
+        text_length = IPP_STREAM_VALUE_MAX - 1;
+    }
+    memcpy(attr->strings[i], text, text_length);
+    attr->strings[i][text_length] = '\0';
+    attr->lengths[i] = text_length;
+}
@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <libcups3/cups/cups.h>
+#include "ipp-stream.h"
+#include "status-shm.h"
+
+// --- Constants ---
+#define HOSTNAME_MAX STATUS_HOSTNAME_MAX
+#define PRINTER_URI_MAX (HOSTNAME_MAX + 32)    // "ipp://", ":<port>" and "/ipp/print" around the longest hostname
+#define DEFAULT_PORT 8000       // As in get-state, so get-state -s finds printers listed without a port
+#define DEFAULT_INTERVAL 2
+#define DEFAULT_WORKERS 8
+#define MAX_PRINTERS 4096
+#define CONNECT_TIMEOUT 5000    // Milliseconds; a dead printer mustn't hold up the rest of its worker's round
+
+// --- Structures ---
+typedef struct {
+    char        hostname[HOSTNAME_MAX];
+    int         port;
+} PrinterAddress;
+
+typedef struct {
+    PrinterAddress printers[MAX_PRINTERS];
+    int            num_printers;
+    int            port;
+    int            interval;
+    int            workers;
+} StatusBoardParams;
+
+// Each worker polls every workers-th printer, keeping a connection to each open between rounds
+typedef struct {
+    const StatusBoardParams *params;
+    StatusBoard             *board;
+    int                      first;
+    http_t                 **connections;
+} PollWorker;
+
+static pthread_mutex_t stop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+static bool stopping = false;
+
+// --- Function Prototypes ---
+bool parse_command_line(int argc, char *argv[], StatusBoardParams *params);
+bool add_printer(StatusBoardParams *params, const char *address);
+bool load_printer_list(StatusBoardParams *params, const char *filename);
+http_t *connect_printer(const PrinterAddress *printer);
+void poll_printer(http_t **http, const PrinterAddress *printer, StatusEntry *entry);
+void append_value(char *buffer, size_t size, const char *separator, const char *value, size_t length);
+void *poll_worker(void *arg);
+
+int main(int argc, char *argv[]) {
+    static StatusBoardParams params;
+    params.port = DEFAULT_PORT;
+    params.interval = DEFAULT_INTERVAL;
+    params.workers = DEFAULT_WORKERS;
+
+    // --- Parse command-line arguments ---
+    if (!parse_command_line(argc, argv, &params)) {
+        return 1;
+    }
+    if (params.workers > params.num_printers) {
+        params.workers = params.num_printers;
+    }
+
+    // --- Create the board; hostnames and ports never change after this ---
+    StatusBoard *board = status_board_create(STATUS_BOARD_NAME, params.num_printers, params.interval);
+    if (!board) {
+        fprintf(stderr, "Error: Unable to create shared memory %s: %s\n", STATUS_BOARD_NAME, strerror(errno));
+        return 1;
+    }
+    for (int i = 0; i < params.num_printers; i++) {
+        snprintf(board->entries[i].hostname, sizeof(board->entries[i].hostname), "%s", params.printers[i].hostname);
+        board->entries[i].port = params.printers[i].port;
+    }
+    status_board_ready(board);
+
+    // Workers inherit this mask, so SIGINT and SIGTERM only ever reach sigwait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // --- Start the pollers ---
+    PollWorker *workers = calloc((size_t)params.workers, sizeof(PollWorker));
+    pthread_t *threads = calloc((size_t)params.workers, sizeof(pthread_t));
+    http_t **connections = calloc((size_t)params.num_printers, sizeof(http_t *));
+    if (!workers || !threads || !connections) {
+        fprintf(stderr, "Error: Out of memory.\n");
+        status_board_remove(STATUS_BOARD_NAME);
+        status_board_close(board);
+        free(connections);
+        free(threads);
+        free(workers);
+        return 1;
+    }
+
+    int started = 0;
+    for (int i = 0; i < params.workers; i++) {
+        workers[i].params = &params;
+        workers[i].board = board;
+        workers[i].first = i;
+        workers[i].connections = connections;
+        if (pthread_create(&threads[i], NULL, poll_worker, &workers[i]) != 0) {
+            fprintf(stderr, "Error: Unable to start poller thread.\n");
+            break;
+        }
+        started++;
+    }
+
+    if (started == params.workers) {
+        printf("Publishing %d printer%s to %s every %d second%s with %d poller%s.\n", params.num_printers,
+               params.num_printers == 1 ? "" : "s", STATUS_BOARD_NAME, params.interval,
+               params.interval == 1 ? "" : "s", params.workers, params.workers == 1 ? "" : "s");
+        fflush(stdout);
+
+        int signal_number;
+        sigwait(&signals, &signal_number);
+    }
+
+    // --- Stop the pollers and take the board down ---
+    pthread_mutex_lock(&stop_lock);
+    stopping = true;
+    pthread_cond_broadcast(&stop_cond);
+    pthread_mutex_unlock(&stop_lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    status_board_remove(STATUS_BOARD_NAME);
+    status_board_close(board);
+    for (int i = 0; i < params.num_printers; i++) {
+        httpClose(connections[i]);
+    }
+    free(connections);
+    free(threads);
+    free(workers);
+
+    return started == params.workers ? 0 : 1;
+}
+
+// --- Function to parse command-line arguments ---
+bool parse_command_line(int argc, char *argv[], StatusBoardParams *params) {
+    const char *printer_list = NULL;
+    const char *addresses[MAX_PRINTERS];
+    int num_addresses = 0;
+    int opt;
+    opterr = 0;
+
+    while ((opt = getopt(argc, argv, "h:H:p:i:w:")) != -1) {
+        switch (opt) {
+            case 'h':
+                if (num_addresses >= MAX_PRINTERS) {
+                    fprintf(stderr, "Error: At most %d printers can be given.\n", MAX_PRINTERS);
+                    return false;
+                }
+                addresses[num_addresses++] = optarg;
+                break;
+            case 'H':
+                printer_list = optarg;
+                break;
+            case 'p':
+                params->port = atoi(optarg);
+                break;
+            case 'i':
+                params->interval = atoi(optarg);
+                break;
+            case 'w':
+                params->workers = atoi(optarg);
+                break;
+
+            case '?':
+                if (strchr("hHpiw", optopt))
+                    fprintf(stderr, "Option -%c requires an argument.\n", optopt);
+                else if (isprint(optopt))
+                    fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+                else
+                    fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    // Ports given with -h/-H default to -p, wherever -p appears
+    for (int i = 0; i < num_addresses; i++) {
+        if (!add_printer(params, addresses[i])) {
+            return false;
+        }
+    }
+    if (printer_list && !load_printer_list(params, printer_list)) {
+        return false;
+    }
+
+    if (params->num_printers == 0 || optind < argc || params->interval < 1 || params->workers < 1) {
+        fprintf(stderr, "Usage: %s (-h <hostname>[:<port>] ... | -H <file>) [-p <port>] [-i <seconds>] [-w <workers>]\n", argv[0]);
+        fprintf(stderr, "  -h <hostname>:  Printer to poll; repeat for more printers.\n");
+        fprintf(stderr, "  -H <file>:      File listing printers, one hostname[:port] per line.\n");
+        fprintf(stderr, "  -p <port>:      Port number for printers given without one (optional, default is %d).\n", DEFAULT_PORT);
+        fprintf(stderr, "  -i <seconds>:   Time between polls of each printer (optional, default is %d).\n", DEFAULT_INTERVAL);
+        fprintf(stderr, "  -w <workers>:   Printers polled at once (optional, default is %d).\n", DEFAULT_WORKERS);
+        fprintf(stderr, "State is published to shared memory %s until SIGINT or SIGTERM; read it with get-state -s.\n", STATUS_BOARD_NAME);
+        return false;
+    }
+
+    return true;
+}
+
+// --- Function to add a hostname[:port] to the printer list (from job-control.c) ---
+bool add_printer(StatusBoardParams *params, const char *address) {
+    if (params->num_printers >= MAX_PRINTERS) {
+        fprintf(stderr, "Error: At most %d printers can be given.\n", MAX_PRINTERS);
+        return false;
+    }
+
+    PrinterAddress *printer = &params->printers[params->num_printers];
+    snprintf(printer->hostname, sizeof(printer->hostname), "%s", address);
+    printer->port = params->port;
+
+    // A single colon separates the port; more than one is an IPv6 address
+    char *colon = strrchr(printer->hostname, ':');
+    if (colon && colon == strchr(printer->hostname, ':')) {
+        *colon = '\0';
+        printer->port = atoi(colon + 1);
+    }
+
+    if (!printer->hostname[0] || printer->port <= 0) {
+        fprintf(stderr, "Error: Bad printer address \"%s\".\n", address);
+        return false;
+    }
+
+    params->num_printers++;
+    return true;
+}
+
+// --- Function to read printers from a file, ignoring blank lines and # comments (from job-control.c) ---
+bool load_printer_list(StatusBoardParams *params, const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Unable to open %s.\n", filename);
+        return false;
+    }
+
+    char line[HOSTNAME_MAX];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        char *start = line;
+        while (isspace((unsigned char)*start)) start++;
+        char *end = start + strcspn(start, "# \t\r\n");
+        *end = '\0';
+
+        if (*start) {
+            ok = add_printer(params, start);
+        }
+    }
+
+    fclose(fp);
+    return ok;
+}
+
+// --- Function to connect the way get-state does, so both see the same printer ---
+http_t *connect_printer(const PrinterAddress *printer) {
+    http_encryption_t encryption = (printer->port == 8000) ? HTTP_ENCRYPTION_ALWAYS : HTTP_ENCRYPTION_IF_REQUESTED;
+    return httpConnect(printer->hostname, printer->port, NULL, AF_UNSPEC, encryption, 1, CONNECT_TIMEOUT, NULL);
+}
+
+// --- Function to poll one printer and publish the result ---
+void poll_printer(http_t **http, const PrinterAddress *printer, StatusEntry *entry) {
+    static const char * const requested_attrs[] = {"printer-state", "printer-state-reasons", "printer-alert"};
+    StatusEntry update;
+    IppStreamResponse response;
+    char printer_uri_str[PRINTER_URI_MAX];
+    bool ok = false;
+
+    // Start from what is published, so a failed poll keeps the last known state.
+    // This thread is the entry's only writer, so it can read it without the seqlock.
+    memcpy(&update, entry, sizeof(update));
+    update.error[0] = '\0';
+
+    if (!*http) {
+        *http = connect_printer(printer);
+    }
+
+    if (!*http) {
+        snprintf(update.error, sizeof(update.error), "unable to connect: %s", cupsGetErrorString());
+    } else if (snprintf(printer_uri_str, sizeof(printer_uri_str), "ipp://%s:%d/ipp/print", printer->hostname,
+                        printer->port) >= (int)sizeof(printer_uri_str)) {
+        // A truncated printer-uri could name some other printer
+        snprintf(update.error, sizeof(update.error), "printer-uri too long");
+    } else {
+        ipp_t *request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, printer_uri_str);
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+        ippAddStrings(request, IPP_TAG_OPERATION, IPP_CONST_TAG(IPP_TAG_KEYWORD), "requested-attributes",
+                      3, NULL, requested_attrs);
+
+        ipp_stream_init(&response, requested_attrs, 3);
+        if (!ipp_stream_do_request(*http, request, "/ipp/print", &response)) {
+            snprintf(update.error, sizeof(update.error), "%s", ipp_stream_error_string(&response));
+            // Start over with a new connection next round
+            httpClose(*http);
+            *http = NULL;
+        } else if (response.status > IPP_STATUS_OK_EVENTS_COMPLETE) {
+            snprintf(update.error, sizeof(update.error), "%s", ipp_stream_error_string(&response));
+        } else {
+            ok = true;
+        }
+        ippDelete(request);
+    }
+
+    if (ok) {
+        const IppStreamAttr *state = ipp_stream_find(&response, "printer-state");
+        const IppStreamAttr *reasons = ipp_stream_find(&response, "printer-state-reasons");
+        const IppStreamAttr *alerts = ipp_stream_find(&response, "printer-alert");
+
+        update.state = state && state->value_tag == IPP_TAG_ENUM ? state->integers[0] : 0;
+        update.reasons[0] = '\0';
+        for (int i = 0; reasons && i < reasons->num_values && i < IPP_STREAM_MAX_VALUES; i++) {
+            append_value(update.reasons, sizeof(update.reasons), ",", reasons->strings[i], reasons->lengths[i]);
+        }
+        update.alerts[0] = '\0';
+        for (int i = 0; alerts && i < alerts->num_values && i < IPP_STREAM_MAX_VALUES; i++) {
+            append_value(update.alerts, sizeof(update.alerts), "\n", alerts->strings[i], alerts->lengths[i]);
+        }
+        update.failures = 0;
+        update.updated = (int64_t)time(NULL);
+    } else {
+        update.failures++;
+    }
+
+    status_board_publish(entry, &update);
+}
+
+// --- Function to append a separated value to a fixed buffer, truncating if full ---
+void append_value(char *buffer, size_t size, const char *separator, const char *value, size_t length) {
+    size_t used = strlen(buffer);
+    snprintf(buffer + used, size - used, "%s%.*s", used ? separator : "", (int)length, value);
+}
+
+// --- Poller thread: a round over its printers every interval until told to stop ---
+void *poll_worker(void *arg) {
+    PollWorker *worker = (PollWorker *)arg;
+    const StatusBoardParams *params = worker->params;
+    struct timespec next, now;
+
+    clock_gettime(CLOCK_REALTIME, &next);
+    pthread_mutex_lock(&stop_lock);
+    while (!stopping) {
+        pthread_mutex_unlock(&stop_lock);
+        for (int i = worker->first; i < params->num_printers; i += params->workers) {
+            poll_printer(&worker->connections[i], &params->printers[i], &worker->board->entries[i]);
+        }
+        pthread_mutex_lock(&stop_lock);
+
+        // Rounds start interval seconds apart; after a round that overran, the next starts right away
+        next.tv_sec += params->interval;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (next.tv_sec < now.tv_sec) {
+            next = now;
+        }
+        while (!stopping && pthread_cond_timedwait(&stop_cond, &stop_lock, &next) != ETIMEDOUT);
+    }
+    pthread_mutex_unlock(&stop_lock);
+
+    return NULL;
+}
@@ -0,0 +1,143 @@
+#include <time.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "status-shm.h"
+
+// Everything from state onwards changes with each poll; hostname and port never do
+#define ENTRY_STATE_OFFSET offsetof(StatusEntry, state)
+#define ENTRY_STATE_SIZE (sizeof(StatusEntry) - ENTRY_STATE_OFFSET)
+
+static size_t board_size(int num_printers);
+
+// --- Function to create the board in shared memory ---
+StatusBoard *status_board_create(const char *name, int num_printers, int interval) {
+    size_t size = board_size(num_printers);
+
+    // A fresh object every time; readers still mapping an old one keep it until they close
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) < 0) {
+        int saved = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = saved;
+        return NULL;
+    }
+
+    StatusBoard *board = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (board == MAP_FAILED) {
+        int saved = errno;
+        shm_unlink(name);
+        errno = saved;
+        return NULL;
+    }
+
+    // ftruncate zero-fills, so only the header needs setting up
+    board->version = STATUS_BOARD_VERSION;
+    board->num_printers = num_printers;
+    board->interval = interval;
+    board->started = (int64_t)time(NULL);
+    return board;
+}
+
+// --- Function to publish the board once the printer addresses are filled in ---
+void status_board_ready(StatusBoard *board) {
+    atomic_store_explicit(&board->magic, STATUS_BOARD_MAGIC, memory_order_release);
+}
+
+// --- Function to remove the board's name ---
+void status_board_remove(const char *name) {
+    shm_unlink(name);
+}
+
+// --- Function to map an existing board read-only ---
+const StatusBoard *status_board_open(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(StatusBoard)) {
+        close(fd);
+        return NULL;
+    }
+
+    const StatusBoard *board = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (board == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (atomic_load_explicit(&((StatusBoard *)board)->magic, memory_order_acquire) != STATUS_BOARD_MAGIC ||
+        board->version != STATUS_BOARD_VERSION || board->num_printers < 0 ||
+        board_size(board->num_printers) > (size_t)st.st_size) {
+        munmap((void *)board, (size_t)st.st_size);
+        return NULL;
+    }
+
+    return board;
+}
+
+// --- Function to unmap a board ---
+void status_board_close(const StatusBoard *board) {
+    if (board) {
+        munmap((void *)board, board_size(board->num_printers));
+    }
+}
+
+// --- Function to update one entry under its seqlock ---
+void status_board_publish(StatusEntry *entry, const StatusEntry *update) {
+    uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+
+    // Odd while writing; the release fence keeps the data stores after the odd sequence
+    atomic_store_explicit(&entry->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy((char *)entry + ENTRY_STATE_OFFSET, (const char *)update + ENTRY_STATE_OFFSET, ENTRY_STATE_SIZE);
+    atomic_store_explicit(&entry->sequence, sequence + 2, memory_order_release);
+}
+
+// --- Function to take a consistent copy of one printer's entry ---
+bool status_board_read(const StatusBoard *board, const char *hostname, int port, StatusEntry *copy) {
+    const StatusEntry *entry = NULL;
+    for (int i = 0; i < board->num_printers && !entry; i++) {
+        if (board->entries[i].port == port && !strcmp(board->entries[i].hostname, hostname)) {
+            entry = &board->entries[i];
+        }
+    }
+    if (!entry) {
+        return false;
+    }
+
+    uint32_t before, after;
+    do {
+        before = atomic_load_explicit(&((StatusEntry *)entry)->sequence, memory_order_acquire);
+        if (before & 1) {
+            sched_yield();              // The poller is mid-update; it only holds it for a memcpy
+            continue;
+        }
+        memcpy((char *)copy + ENTRY_STATE_OFFSET, (const char *)entry + ENTRY_STATE_OFFSET, ENTRY_STATE_SIZE);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&((StatusEntry *)entry)->sequence, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    atomic_init(&copy->sequence, before);
+    copy->port = entry->port;
+    memcpy(copy->hostname, entry->hostname, sizeof(copy->hostname));
+    return true;
+}
+
+// --- Helper to size a board for num_printers printers ---
+static size_t board_size(int num_printers) {
+    return sizeof(StatusBoard) + (size_t)num_printers * sizeof(StatusEntry);
+}